@@ -0,0 +1,76 @@
+/*----------------------------------------------------------------------------------*
+ * An example of updating the flip-disc displays without blocking loop()            *
+ * The displays are updated in the QUEUE mode, while a second task                  *
+ * (the built-in LED blinking) keeps running at its own pace                        *
+ *                                                                                  *
+ * The MIT License                                                                  *
+ * Marcin Saj 15 Jan 2023                                                           *
+ * https://github.com/marcinsaj/FlipDisc                                            *
+ *                                                                                  *
+ * A dedicated controller or any Arduino board with a power module is required      * 
+ * to operate the display:                                                          *
+ * 1. Dedicated controller - https://bit.ly/AC1-FD                                  *
+ * 2. Or any Arduino board + Pulse Shaper Power Supply - https://bit.ly/PSPS-FD     *                       
+ *----------------------------------------------------------------------------------*/
+
+#include <FlipDisc.h>   // https://github.com/marcinsaj/FlipDisc 
+
+// Example pin declaration for Arduino Uno and PSPS module
+#define EN_PIN  10
+#define CH_PIN  8 
+#define PL_PIN  9
+
+uint8_t counter = 0;
+uint32_t led_time = 0;
+
+/* Handles of the display updates - the update of each display advances 
+every time the queue is serviced in loop() */
+FlipTask digit_task;
+FlipTask matrix_task;
+
+void setup() 
+{
+  Serial.begin(9600);
+  pinMode(LED_BUILTIN, OUTPUT);
+  
+  Flip.Pin(EN_PIN, CH_PIN, PL_PIN);
+  Flip.Init(D7SEG, D3X5);
+  Flip.Clear();
+  
+  Flip.Delay(20);
+
+  /* In the QUEUE mode the display functions return immediately 
+  and the discs are flipped by Flip.Service() */
+  Flip.Mode(QUEUE);
+}
+
+void loop() 
+{
+  /* Task 1 - display the next number when the previous one is fully shown */
+  if(digit_task.Done() == true && matrix_task.Done() == true)
+  {
+    counter = (counter + 1) % 10;
+    
+    digit_task = Flip.Display_7Seg(1, counter);
+    matrix_task = Flip.Display_3x5(1, counter);
+
+    /* The callback is called once, right after the last disc of the 7-segment display flips */
+    digit_task.OnDone(DigitDone);
+  }
+
+  /* Task 2 - blink the LED every 100ms, independently of the display */
+  if(millis() - led_time >= 100)
+  {
+    led_time = millis();
+    digitalWrite(LED_BUILTIN, !digitalRead(LED_BUILTIN));
+  }
+
+  /* Flip the discs, but spend at most 5ms in each loop() iteration */
+  Flip.Service(5000);
+}
+
+void DigitDone(void)
+{
+  /* Progress of the 3x5 display update in percent, 0-100 */
+  Serial.println(matrix_task.Progress());
+}
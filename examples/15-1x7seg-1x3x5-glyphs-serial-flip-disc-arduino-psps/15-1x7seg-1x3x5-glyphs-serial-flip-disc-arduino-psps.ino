@@ -0,0 +1,108 @@
+/*----------------------------------------------------------------------------------*
+ * An example of printing all symbols of the 7-segment and 3x5 displays             *
+ * The symbols are displayed one by one and each flipped disc is reported           *
+ * by the Flip.OnFlip() callback, so the serial monitor shows the symbols           *
+ * as the discs are really set - a reference picture of every symbol.               *
+ * Save the output and compare it after changing the library, any difference       *
+ * shows a changed symbol.                                                          *
+ *                                                                                  *
+ * The MIT License                                                                  *
+ * Marcin Saj 15 Jan 2023                                                           *
+ * https://github.com/marcinsaj/FlipDisc                                            *
+ *                                                                                  *
+ * A dedicated controller or any Arduino board with a power module is required      * 
+ * to operate the display:                                                          *
+ * 1. Dedicated controller - https://bit.ly/AC1-FD                                  *
+ * 2. Or any Arduino board + Pulse Shaper Power Supply - https://bit.ly/PSPS-FD     *                       
+ *----------------------------------------------------------------------------------*/
+
+#include <FlipDisc.h>   // https://github.com/marcinsaj/FlipDisc 
+
+// Example pin declaration for Arduino Uno and PSPS module
+#define EN_PIN  10
+#define CH_PIN  8 
+#define PL_PIN  9
+
+/* Disc numbers of the 7-segment display, -1 - no disc
+ *  0  1  2  3  4
+ * 19           5
+ * 18           6
+ * 17 20 21 22  7
+ * 16           8
+ * 15           9
+ * 14 13 12 11 10
+ */
+const int8_t discs7Seg[7][5] = 
+{
+  { 0,  1,  2,  3,  4},
+  {19, -1, -1, -1,  5},
+  {18, -1, -1, -1,  6},
+  {17, 20, 21, 22,  7},
+  {16, -1, -1, -1,  8},
+  {15, -1, -1, -1,  9},
+  {14, 13, 12, 11, 10}
+};
+
+/* The last status of each disc reported by the callback */
+bool discs_7seg[23];
+bool discs_3x5[15];
+
+void setup() 
+{
+  Serial.begin(9600);
+  
+  Flip.Pin(EN_PIN, CH_PIN, PL_PIN);
+  Flip.Init(D7SEG, D3X5);
+  Flip.Delay(0);
+
+  /* Called after each flipped disc, the disc numbers count from 0 */
+  Flip.OnFlip(DiscFlipped);
+
+  /* All symbols of the 7-segment display - 0-45 */
+  for(uint8_t symbol = 0; symbol < 46; symbol++)
+  {
+    Flip.Display_7Seg(1, symbol);
+    
+    Serial.print("D7SEG ");
+    Serial.println(symbol);
+    
+    for(uint8_t row = 0; row < 7; row++)
+    {
+      for(uint8_t column = 0; column < 5; column++)
+      {
+        int8_t disc = discs7Seg[row][column];
+        
+        if(disc < 0) Serial.print(' ');
+        else Serial.print(discs_7seg[disc] == 1 ? '#' : '.');
+      }
+      Serial.println();
+    }
+  }
+
+  /* All symbols of the 3x5 display - 0-67 */
+  for(uint8_t symbol = 0; symbol < 68; symbol++)
+  {
+    Flip.Display_3x5(1, symbol);
+    
+    Serial.print("D3X5 ");
+    Serial.println(symbol);
+    
+    /* The discs of the 3x5 display are numbered from the bottom row */
+    for(int8_t row = 4; row >= 0; row--)
+    {
+      for(uint8_t column = 0; column < 3; column++)
+      {
+        Serial.print(discs_3x5[3 * row + column] == 1 ? '#' : '.');
+      }
+      Serial.println();
+    }
+  }
+}
+
+void loop() {}
+
+void DiscFlipped(uint8_t module_type, uint8_t module_number, uint8_t disc_number, bool disc_status, uint32_t flip_time)
+{
+  if(module_type == D7SEG) discs_7seg[disc_number] = disc_status;
+  if(module_type == D3X5) discs_3x5[disc_number] = disc_status;
+}
@@ -0,0 +1,259 @@
+/*----------------------------------------------------------------------------------*
+ * chain.cpp - simulated chain of flip-disc displays for the host tests             *
+ * of the FlipDisc library, see chain.h.                                            *
+ *----------------------------------------------------------------------------------*/
+
+#include "chain.h"
+#include <stdio.h>
+
+/*
+ * Control tables of one display type, the same tables the library sends.
+ * -> set_status - the disc status selected by setDiscArray, the 7-segment display 
+ *    sends setDiscArray_7Seg for the status "0", the other displays for "1"
+ */
+typedef struct
+{
+  uint8_t module_type;
+  uint8_t number_bytes;
+  uint8_t number_discs;
+  const uint8_t *set_table;
+  const uint8_t *reset_table;
+  bool set_status;
+} ChainModule;
+
+static const ChainModule chainModuleArray[] =
+{
+  {D7SEG,  3, 23, &setDiscArray_7Seg[0][0],   &resetDiscArray_7Seg[0][0],   0},
+  {D2X1,   1,  2, &setDiscArray_3x1[0],       &resetDiscArray_3x1[0],       1},
+  {D3X1,   1,  3, &setDiscArray_3x1[0],       &resetDiscArray_3x1[0],       1},
+  {D1X3,   1,  3, &setDiscArray_1x3[0],       &resetDiscArray_1x3[0],       1},
+  {D1X7,   2,  7, &setDiscArray_1x7[0][0],    &resetDiscArray_1x7[0][0],    1},
+  {D2X6,   2, 12, &setDiscArray_2x6[0][0],    &resetDiscArray_2x6[0][0],    1},
+  {D3X3,   2,  9, &setDiscArray_3x3[0][0],    &resetDiscArray_3x3[0][0],    1},
+  {D3X4,   2, 12, &setDiscArray_3x4[0][0],    &resetDiscArray_3x4[0][0],    1},
+  {D3X5,   2, 15, &setDiscArray_3x5[0][0],    &resetDiscArray_3x5[0][0],    1},
+  {D4X3X3, 3, 36, &setDiscArray_4x3x3[0][0],  &resetDiscArray_4x3x3[0][0],  1}
+};
+
+static const uint8_t chain_module_types = sizeof(chainModuleArray) / sizeof(chainModuleArray[0]);
+
+static uint8_t chain_types[8];                // Module types as declared in Init()
+static const ChainModule *chain_modules[8];   // NULL - undeclared module, 3 empty bytes
+static uint8_t chain_offset[8];               // Offset of the module bytes in the frame
+static uint8_t chain_bytes = 0;               // Length of the frame of the whole chain
+
+static uint8_t chain_shift[256];              // Bytes shifted in since EN low
+static uint16_t chain_shifted = 0;
+static uint8_t chain_latch[256];              // Control outputs latched by EN high
+static uint16_t chain_latched = 0;
+static bool chain_en = HIGH;
+static bool chain_ch = LOW;
+static bool chain_pl = LOW;
+
+static uint8_t chain_discs[8][36];            // Disc statuses, chain_unknown - never flipped
+static uint32_t chain_pulses = 0;
+static uint32_t chain_errors = 0;
+
+static void (*pulse_callback)(uint8_t module_position, uint8_t disc_number, bool disc_status) = NULL;
+
+SPIClass SPI;
+
+void SPIClass::begin(void)
+{
+}
+
+uint8_t SPIClass::transfer(uint8_t data)
+{
+  ChainSpi(data);
+  return 0;
+}
+
+void digitalWrite(uint8_t pin, uint8_t level)
+{
+  ChainPin(pin, level);
+}
+
+/*----------------------------------------------------------------------------------*
+ * Builds the chain of displays in the order of Init(), all discs unknown,          *
+ * EN high, CH and PL low                                                           *
+ *----------------------------------------------------------------------------------*/
+void ChainBegin(const uint8_t module_types[8])
+{
+  for(int module_position = 0; module_position < 8; module_position++)
+  {
+    chain_types[module_position] = module_types[module_position];
+    chain_modules[module_position] = NULL;
+
+    for(int i = 0; i < chain_module_types; i++)
+    {
+      if(chainModuleArray[i].module_type == module_types[module_position]) chain_modules[module_position] = &chainModuleArray[i];
+    }
+  }
+
+  // The bytes of the last display in the chain are sent first
+  chain_bytes = 0;
+  for(int module_position = 7; module_position >= 0; module_position--)
+  {
+    chain_offset[module_position] = chain_bytes;
+    if(chain_modules[module_position] != NULL) chain_bytes = chain_bytes + chain_modules[module_position]->number_bytes;
+    else chain_bytes = chain_bytes + 3;
+  }
+
+  memset(chain_discs, chain_unknown, sizeof(chain_discs));
+  chain_shifted = 0;
+  chain_latched = 0;
+  chain_en = HIGH;
+  chain_ch = LOW;
+  chain_pl = LOW;
+  chain_pulses = 0;
+  chain_errors = 0;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Absolute position 0-7 of the display, 0xFF - not declared, like the library      *
+ *----------------------------------------------------------------------------------*/
+uint8_t ChainPosition(uint8_t module_type, uint8_t module_number)
+{
+  uint8_t module_count = 0;
+
+  for(int module_position = 0; module_position < 8; module_position++)
+  {
+    if((chain_modules[module_position] == NULL) || (chain_types[module_position] != module_type)) continue;
+    module_count = module_count + 1;
+    if(module_count == module_number) return module_position;
+  }
+
+  return 0xFF;
+}
+
+uint8_t ChainDiscs(uint8_t module_position)
+{
+  if((module_position >= 8) || (chain_modules[module_position] == NULL)) return 0;
+  return chain_modules[module_position]->number_discs;
+}
+
+uint8_t ChainDisc(uint8_t module_position, uint8_t disc_number)
+{
+  if((module_position >= 8) || (disc_number >= 36)) return chain_unknown;
+  return chain_discs[module_position][disc_number];
+}
+
+uint32_t ChainPulses(void)
+{
+  return chain_pulses;
+}
+
+uint32_t ChainErrors(void)
+{
+  return chain_errors;
+}
+
+void ChainOnPulse(void (*new_pulse_callback)(uint8_t module_position, uint8_t disc_number, bool disc_status))
+{
+  pulse_callback = new_pulse_callback;
+}
+
+void ChainFail(const char *message)
+{
+  chain_errors = chain_errors + 1;
+  if(chain_errors <= 10) printf("  chain: %s (pulse %lu)\n", message, (unsigned long)chain_pulses);
+}
+
+void ChainSpi(uint8_t data)
+{
+  if(chain_en != LOW) ChainFail("SPI byte sent while EN is high");
+  if(chain_shifted < sizeof(chain_shift)) chain_shift[chain_shifted] = data;
+  chain_shifted = chain_shifted + 1;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Decodes the latched control outputs of the current pulse.                        *
+ * Exactly one display may have control outputs set, and they must be               *
+ * one row of its setDiscArray or resetDiscArray table - one coil pair.             *
+ *----------------------------------------------------------------------------------*/
+static void ChainPulse(void)
+{
+  chain_pulses = chain_pulses + 1;
+
+  if(chain_ch == HIGH) ChainFail("current pulse while charging");
+  if(chain_en == LOW) ChainFail("current pulse while the frame is being sent");
+  if(chain_latched != chain_bytes)
+  {
+    ChainFail("latched frame length differs from the chain");
+    return;
+  }
+
+  uint8_t pulse_position = 0xFF;
+
+  for(int module_position = 0; module_position < 8; module_position++)
+  {
+    uint8_t number_bytes = (chain_modules[module_position] != NULL) ? chain_modules[module_position]->number_bytes : 3;
+    
+    for(int byte_number = 0; byte_number < number_bytes; byte_number++)
+    {
+      if(chain_latch[chain_offset[module_position] + byte_number] == 0) continue;
+      if((pulse_position != 0xFF) && (pulse_position != module_position)) ChainFail("control outputs of two displays driven");
+      pulse_position = module_position;
+    }
+  }
+
+  if(pulse_position == 0xFF) return;
+
+  const ChainModule *module = chain_modules[pulse_position];
+  if(module == NULL)
+  {
+    ChainFail("control outputs of an undeclared display driven");
+    return;
+  }
+
+  const uint8_t *module_latch = &chain_latch[chain_offset[pulse_position]];
+  uint8_t decoded = 0;
+
+  for(int disc_number = 0; disc_number < module->number_discs; disc_number++)
+  {
+    const uint8_t *set_row = module->set_table + disc_number * module->number_bytes;
+    const uint8_t *reset_row = module->reset_table + disc_number * module->number_bytes;
+
+    if(memcmp(module_latch, set_row, module->number_bytes) == 0)
+    {
+      chain_discs[pulse_position][disc_number] = module->set_status;
+      if(pulse_callback != NULL) pulse_callback(pulse_position, disc_number, module->set_status);
+      decoded = decoded + 1;
+    }
+
+    if(memcmp(module_latch, reset_row, module->number_bytes) == 0)
+    {
+      chain_discs[pulse_position][disc_number] = !module->set_status;
+      if(pulse_callback != NULL) pulse_callback(pulse_position, disc_number, !module->set_status);
+      decoded = decoded + 1;
+    }
+  }
+
+  if(decoded != 1) ChainFail("control outputs are not one coil pair of the display");
+}
+
+void ChainPin(uint8_t pin, uint8_t level)
+{
+  if(pin == chain_en_pin)
+  {
+    if((chain_en == HIGH) && (level == LOW)) chain_shifted = 0;
+    if((chain_en == LOW) && (level == HIGH))
+    {
+      chain_latched = (chain_shifted < sizeof(chain_latch)) ? chain_shifted : sizeof(chain_latch);
+      memcpy(chain_latch, chain_shift, chain_latched);
+    }
+    chain_en = level;
+  }
+
+  if(pin == chain_ch_pin)
+  {
+    if((level == HIGH) && (chain_pl == HIGH)) ChainFail("charging during the current pulse");
+    chain_ch = level;
+  }
+
+  if(pin == chain_pl_pin)
+  {
+    if((chain_pl == LOW) && (level == HIGH)) ChainPulse();
+    chain_pl = level;
+  }
+}
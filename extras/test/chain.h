@@ -0,0 +1,38 @@
+/*----------------------------------------------------------------------------------*
+ * chain.h - simulated chain of flip-disc displays for the host tests               *
+ * of the FlipDisc library.                                                         *
+ * The chain replaces the pins and the SPI bus of the Arduino: the bytes sent       *
+ * between EN low and EN high are latched into the shift registers of the displays, *
+ * and each current pulse (PL high) flips the disc selected by the latched          *
+ * control outputs. Every pulse is checked - the frame must have the length of the  *
+ * whole chain and exactly one coil pair of one display may be driven, decoded with *
+ * the setDiscArray/resetDiscArray tables of the library. Violations are counted    *
+ * and printed by ChainFail().                                                      *
+ *----------------------------------------------------------------------------------*/
+
+#ifndef chain_h
+#define chain_h
+
+#include <FlipDisc.h>
+
+// Pins of the simulated controller - Flip.Pin(chain_en_pin, chain_ch_pin, chain_pl_pin)
+static const uint8_t chain_en_pin = 10;
+static const uint8_t chain_ch_pin = 8;
+static const uint8_t chain_pl_pin = 9;
+
+// Status of a disc never flipped since ChainBegin()
+static const uint8_t chain_unknown = 0xFF;
+
+void ChainBegin(const uint8_t module_types[8]);
+void ChainPin(uint8_t pin, uint8_t level);
+void ChainSpi(uint8_t data);
+void ChainFail(const char *message);
+void ChainOnPulse(void (*new_pulse_callback)(uint8_t module_position, uint8_t disc_number, bool disc_status));
+
+uint8_t ChainPosition(uint8_t module_type, uint8_t module_number);
+uint8_t ChainDiscs(uint8_t module_position);
+uint8_t ChainDisc(uint8_t module_position, uint8_t disc_number);
+uint32_t ChainPulses(void);
+uint32_t ChainErrors(void);
+
+#endif
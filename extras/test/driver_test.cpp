@@ -0,0 +1,215 @@
+/*----------------------------------------------------------------------------------*
+ * driver_test.cpp - host test of the ESP32 driver task of the FlipDisc library.    *
+ * The library is built with ARDUINO_ARCH_ESP32 on the FreeRTOS stub                *
+ * (stubs/freertos.h), the driver task started by Driver() is a std::thread.        *
+ * Several producer threads call Display_3x5() on their own displays at the same    *
+ * time (and Frame() in the frame mode), so the lock-free driver queue is filled    *
+ * by many producers while the driver task takes the commands and flips the discs.  *
+ * The main thread meanwhile polls FlipTask Done()/Progress() of the displays.      *
+ * Built with ThreadSanitizer by the Makefile. The properties:                      *
+ * -> every current pulse drives exactly one coil pair (checked by the chain)       *
+ * -> after the producers have finished, OnDone() of each display is called         *
+ *    exactly once and then every display shows the last symbol of its producer     *
+ * -> Done() is never 1 while a display still shows the wrong symbol, once          *
+ *    the last symbol has been sent                                                 *
+ * Usage: driver_test [number_cases] [first_seed]                                   *
+ *----------------------------------------------------------------------------------*/
+
+#include "chain.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+static const uint8_t driver_producers = 4;       // One producer per 3x5 display
+static const uint16_t driver_calls = 300;        // Display_3x5() calls of each producer
+static const uint32_t driver_timeout = 20000;    // Wall time in ms for the last symbols
+
+static std::atomic<uint8_t> doneCountArray[driver_producers];
+static std::atomic<uint32_t> driver_micros(0);
+
+/*----------------------------------------------------------------------------------*
+ * Clock of the test - the waits take no real time as with VIRTUAL_CLOCK, but       *
+ * the time also runs on by 10us at every reading, so the driver task polling       *
+ * in idle time sees the frame interval pass                                        *
+ *----------------------------------------------------------------------------------*/
+static uint32_t DriverMicros(void)
+{
+  return driver_micros += 10;
+}
+
+static uint32_t DriverMillis(void)
+{
+  return DriverMicros() / 1000;
+}
+
+static void DriverWait(uint32_t wait_time)
+{
+  driver_micros += wait_time;
+}
+
+// A data race found by ThreadSanitizer fails the case, also after _exit()
+extern "C" const char *__tsan_default_options(void)
+{
+  return "halt_on_error=1";
+}
+
+/*----------------------------------------------------------------------------------*
+ * OnDone() callbacks - one function per display, as the callback has no argument   *
+ *----------------------------------------------------------------------------------*/
+template<int module_position> static void DriverDone(void)
+{
+  doneCountArray[module_position]++;
+}
+
+static void (*const doneCallbackArray[driver_producers])(void) =
+{
+  DriverDone<0>, DriverDone<1>, DriverDone<2>, DriverDone<3>
+};
+
+/*----------------------------------------------------------------------------------*
+ * 1 - the display shows the symbol of displayArray_3x5                             *
+ *----------------------------------------------------------------------------------*/
+static bool DriverShows(uint8_t module_position, uint8_t symbol)
+{
+  for(int disc_number = 0; disc_number < 15; disc_number++)
+  {
+    uint8_t column = (disc_number < 8) ? 0 : 1;
+    bool disc_status = (pgm_read_byte(&displayArray_3x5[symbol][column]) >> (disc_number % 8)) & 1;
+    if(ChainDisc(module_position, disc_number) != disc_status) return 0;
+  }
+  return 1;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Producer thread - random symbols on its own display, the last one is returned    *
+ *----------------------------------------------------------------------------------*/
+static void DriverProducer(uint8_t module_position, uint32_t producer_random, bool frame_mode, uint8_t *last_symbol)
+{
+  for(int call_number = 0; call_number < driver_calls; call_number++)
+  {
+    producer_random ^= producer_random << 13;
+    producer_random ^= producer_random >> 17;
+    producer_random ^= producer_random << 5;
+
+    *last_symbol = producer_random % 68;
+    Flip.Display_3x5(module_position + 1, *last_symbol);
+
+    if((frame_mode == true) && (producer_random % 8 == 0)) Flip.Frame();
+    if(producer_random % 16 == 0) std::this_thread::yield();
+  }
+}
+
+/*----------------------------------------------------------------------------------*
+ * One case - even seeds without frames, odd seeds with FrameRate()                 *
+ *----------------------------------------------------------------------------------*/
+static bool DriverCase(uint32_t seed)
+{
+  const uint8_t chainArray[8] = {D3X5, D3X5, D3X5, D3X5, NONE, NONE, NONE, NONE};
+  bool frame_mode = (seed % 2 == 1);
+  uint8_t lastArray[driver_producers];
+
+  Flip.Clock(DriverMicros, DriverMillis, DriverWait);
+  Flip.Pin(chain_en_pin, chain_ch_pin, chain_pl_pin);
+  ChainBegin(chainArray);
+  Flip.Init(D3X5, D3X5, D3X5, D3X5);
+  if(frame_mode == true) Flip.FrameRate(50);
+
+  if(Flip.Driver() == false)
+  {
+    ChainFail("driver task not started");
+    return 0;
+  }
+
+  std::thread producerArray[driver_producers];
+  for(int module_position = 0; module_position < driver_producers; module_position++)
+  {
+    producerArray[module_position] = std::thread(DriverProducer, module_position, seed * 7919 + module_position + 1,
+                                                 frame_mode, &lastArray[module_position]);
+  }
+
+  // Polled while the producers run - must not crash or race, the result may be anything
+  for(int poll_number = 0; poll_number < 1000; poll_number++)
+  {
+    FlipTask flip_task(poll_number % driver_producers);
+    if(flip_task.Progress() > 100) ChainFail("Progress() above 100");
+  }
+
+  for(int module_position = 0; module_position < driver_producers; module_position++) producerArray[module_position].join();
+
+  // The last frame written by the producers
+  if(frame_mode == true) Flip.Frame();
+
+  for(int module_position = 0; module_position < driver_producers; module_position++)
+  {
+    FlipTask(module_position).OnDone(doneCallbackArray[module_position]);
+  }
+
+  std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+  bool all_done = false;
+
+  while(all_done == false)
+  {
+    all_done = true;
+    for(int module_position = 0; module_position < driver_producers; module_position++)
+    {
+      if(doneCountArray[module_position] == 0)
+      {
+        all_done = false;
+        continue;
+      }
+
+      // OnDone() has been called - the display must show the last symbol and stay done
+      if(DriverShows(module_position, lastArray[module_position]) == false) ChainFail("OnDone() before the last symbol");
+      if(FlipTask(module_position).Done() == false) ChainFail("Done() is 0 after OnDone()");
+    }
+
+    if(std::chrono::steady_clock::now() - start_time > std::chrono::milliseconds(driver_timeout))
+    {
+      ChainFail("OnDone() not called");
+      return 0;
+    }
+    std::this_thread::yield();
+  }
+
+  // Time for a second, wrong call of the callbacks
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  for(int module_position = 0; module_position < driver_producers; module_position++)
+  {
+    if(doneCountArray[module_position] != 1) ChainFail("OnDone() called more than once");
+    if(FlipTask(module_position).Progress() != 100) ChainFail("Progress() below 100 after OnDone()");
+  }
+
+  return (ChainErrors() == 0);
+}
+
+int main(int argc, char *argv[])
+{
+  uint32_t number_cases = (argc > 1) ? strtoul(argv[1], NULL, 0) : 20;
+  uint32_t first_seed = (argc > 2) ? strtoul(argv[2], NULL, 0) : 1;
+  uint32_t failed_cases = 0;
+
+  for(uint32_t seed = first_seed; seed < first_seed + number_cases; seed++)
+  {
+    // The driver task never ends - each case runs in its own process
+    pid_t case_process = fork();
+    if(case_process == 0)
+    {
+      bool passed = DriverCase(seed);
+      if(passed == false) printf("driver_test: seed %u FAILED\n", seed);
+      fflush(stdout);
+      _exit(passed ? 0 : 1);
+    }
+
+    int case_status = 0;
+    waitpid(case_process, &case_status, 0);
+    if((WIFEXITED(case_status) == 0) || (WEXITSTATUS(case_status) != 0)) failed_cases++;
+  }
+
+  printf("driver_test: %u cases, %u failed\n", number_cases, failed_cases);
+  return (failed_cases == 0) ? 0 : 1;
+}
@@ -0,0 +1,381 @@
+/*----------------------------------------------------------------------------------*
+ * fuzz_test.cpp - property test of the public API of the FlipDisc library.         *
+ * Each case declares a random chain of displays and drives a random sequence       *
+ * of calls with random module numbers, disc numbers, symbols and modes,            *
+ * also out of range. The library runs on the simulated chain (chain.cpp),          *
+ * built with AddressSanitizer and UndefinedBehaviorSanitizer by the Makefile,      *
+ * so any out-of-bounds table read stops the case. The properties:                  *
+ * -> every current pulse drives exactly one coil pair (checked by the chain)       *
+ * -> every pulse is reported by OnFlip() with the disc decoded by the chain        *
+ * -> after Flush() the queue is empty and every disc set by a Disc_*() call        *
+ *    shows the last status of the call                                             *
+ * Each case runs in its own process - Init() can be called only once.              *
+ * Usage: fuzz_test [number_cases] [first_seed]                                     *
+ * With -DFLIPDISC_LIBFUZZER the file is a libFuzzer target instead,                *
+ * the random values are taken from the fuzzer input, see "make fuzz".              *
+ *----------------------------------------------------------------------------------*/
+
+#include "chain.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static const uint8_t fuzzTypeArray[] = {D7SEG, D2X1, D3X1, D1X3, D1X7, D2X6, D3X3, D3X4, D3X5, D4X3X3};
+static const uint8_t fuzz_number_types = sizeof(fuzzTypeArray);
+
+static uint8_t fuzz_types[8];
+static uint8_t targetArray[8][36];     // The last status set by Disc_*(), chain_unknown - any status
+static uint32_t fuzz_random = 1;       // xorshift32 state
+static const uint8_t *fuzz_data = NULL;
+static size_t fuzz_size = 0;
+static uint32_t flips_reported = 0;
+static uint8_t pulse_position = 0xFF;  // The last disc decoded by the chain
+static uint8_t pulse_disc = 0;
+static bool pulse_status = 0;
+
+/*----------------------------------------------------------------------------------*
+ * Random value - from the fuzzer input if there is one, otherwise xorshift32       *
+ *----------------------------------------------------------------------------------*/
+static uint32_t Random(void)
+{
+  if(fuzz_data != NULL)
+  {
+    uint32_t value = 0;
+    for(int i = 0; i < 4; i++)
+    {
+      value = value << 8;
+      if(fuzz_size > 0)
+      {
+        value = value | *fuzz_data++;
+        fuzz_size = fuzz_size - 1;
+      }
+    }
+    return value;
+  }
+
+  fuzz_random ^= fuzz_random << 13;
+  fuzz_random ^= fuzz_random >> 17;
+  fuzz_random ^= fuzz_random << 5;
+  return fuzz_random;
+}
+
+// Mostly valid values, sometimes any byte
+static uint8_t RandomModule(void)
+{
+  if(Random() % 16 == 0) return Random();
+  return Random() % 4;
+}
+
+static uint8_t RandomDisc(void)
+{
+  if(Random() % 16 == 0) return Random();
+  return Random() % 40;
+}
+
+static uint8_t RandomType(void)
+{
+  if(Random() % 16 == 0) return Random();
+  return fuzzTypeArray[Random() % fuzz_number_types];
+}
+
+static uint8_t RandomDot(void)
+{
+  const uint8_t dotArray[] = {0, 1, 0xFF};
+  if(Random() % 16 == 0) return Random();
+  return dotArray[Random() % 3];
+}
+
+static void Fail(const char *message)
+{
+  ChainFail(message);
+}
+
+/*----------------------------------------------------------------------------------*
+ * Pulse decoded by the chain and the flip reported by the library                  *
+ *----------------------------------------------------------------------------------*/
+static void ChainPulse(uint8_t module_position, uint8_t disc_number, bool disc_status)
+{
+  pulse_position = module_position;
+  pulse_disc = disc_number;
+  pulse_status = disc_status;
+}
+
+static void FlipReported(uint8_t module_type, uint8_t module_number, uint8_t disc_number, bool disc_status, uint32_t)
+{
+  flips_reported = flips_reported + 1;
+
+  if(flips_reported != ChainPulses()) Fail("OnFlip() not called once for each pulse");
+  if((ChainPosition(module_type, module_number) != pulse_position) || (disc_number != pulse_disc) || (disc_status != pulse_status))
+  {
+    Fail("OnFlip() reports another disc than the pulse");
+  }
+}
+
+/*----------------------------------------------------------------------------------*
+ * The displays changed by a call without a simple model have any status            *
+ *----------------------------------------------------------------------------------*/
+static void TargetAny(uint8_t module_position)
+{
+  if(module_position < 8) memset(targetArray[module_position], chain_unknown, sizeof(targetArray[module_position]));
+}
+
+static void TargetAnyAll(void)
+{
+  for(int module_position = 0; module_position < 8; module_position++) TargetAny(module_position);
+}
+
+/*----------------------------------------------------------------------------------*
+ * Disc_*() call - the disc numbers start from 1, only the 7-segment display        *
+ * counts from 0                                                                    *
+ *----------------------------------------------------------------------------------*/
+static void FuzzDisc(void)
+{
+  uint8_t module_type = fuzzTypeArray[Random() % fuzz_number_types];
+  uint8_t module_number = RandomModule();
+  uint8_t disc_number = RandomDisc();
+  bool disc_status = Random() & 1;
+
+  switch(module_type)
+  {
+    case D7SEG:  Flip.Disc_7Seg(module_number, disc_number, disc_status); break;
+    case D2X1:   Flip.Disc_2x1(module_number, disc_number, disc_status); break;
+    case D3X1:   Flip.Disc_3x1(module_number, disc_number, disc_status); break;
+    case D1X3:   Flip.Disc_1x3(module_number, disc_number, disc_status); break;
+    case D1X7:   Flip.Disc_1x7(module_number, disc_number, disc_status); break;
+    case D2X6:   Flip.Disc_2x6(module_number, disc_number, disc_status); break;
+    case D3X3:   Flip.Disc_3x3(module_number, disc_number, disc_status); break;
+    case D3X4:   Flip.Disc_3x4(module_number, disc_number, disc_status); break;
+    case D3X5:   Flip.Disc_3x5(module_number, disc_number, disc_status); break;
+    case D4X3X3: Flip.Disc_4x3x3(module_number, disc_number, disc_status); break;
+  }
+
+  uint8_t module_position = ChainPosition(module_type, module_number);
+  if(module_position == 0xFF) return;
+
+  if(module_type != D7SEG) disc_number = disc_number - 1;
+  if(disc_number < ChainDiscs(module_position)) targetArray[module_position][disc_number] = disc_status;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Display_*() call of one display                                                  *
+ *----------------------------------------------------------------------------------*/
+static void FuzzDisplay(void)
+{
+  uint8_t module_type = fuzzTypeArray[Random() % fuzz_number_types];
+  uint8_t module_number = RandomModule();
+  uint8_t data_type = (Random() % 2 == 0) ? DICE : NUMB;
+  if(Random() % 16 == 0) data_type = Random();
+
+  switch(module_type)
+  {
+    case D7SEG:  Flip.Display_7Seg(module_number, Random()); break;
+    case D2X1:   Flip.Display_2x1(module_number, RandomDot(), RandomDot()); break;
+    case D3X1:   Flip.Display_3x1(module_number, RandomDot(), RandomDot(), RandomDot()); break;
+    case D1X3:   Flip.Display_1x3(module_number, RandomDot(), RandomDot(), RandomDot()); break;
+    case D1X7:   Flip.Display_1x7(module_number, RandomDot(), RandomDot(), RandomDot(), RandomDot(),
+                                  RandomDot(), RandomDot(), RandomDot()); break;
+    case D2X6:   Flip.Display_2x6(module_number, RandomDisc(), RandomDisc(), Random() & 1); break;
+    case D3X3:   Flip.Display_3x3(module_number, Random(), data_type); break;
+    case D3X4:   Flip.Display_3x4(module_number, RandomDisc(), RandomDisc(), Random() & 1); break;
+    case D3X5:   Flip.Display_3x5(module_number, Random()); break;
+    case D4X3X3: Flip.Display_4x3x3(module_number, Random() % 6, Random(), data_type); break;
+  }
+
+  TargetAny(ChainPosition(module_type, module_number));
+}
+
+/*----------------------------------------------------------------------------------*
+ * Calls of several displays, text and numbers                                      *
+ *----------------------------------------------------------------------------------*/
+static void FuzzMatrix(void)
+{
+  switch(Random() % 6)
+  {
+    case 0:
+      Flip.Matrix_7Seg(Random(), Random(), Random(), Random(), Random(), Random(), Random(), Random());
+      break;
+
+    case 1:
+      Flip.Matrix_3x5(Random(), Random(), Random(), Random(), Random(), Random(), Random(), Random());
+      break;
+
+    case 2:
+      Flip.Text((Random() % 2 == 0) ? D7SEG : D3X5, RandomModule());
+      for(int i = Random() % 12; i > 0; i--) Flip.write((uint8_t)Random());
+      break;
+
+    case 3:
+      Flip.Number((int32_t)Random() >> (Random() % 32), Random() % 10, (Random() % 2 == 0) ? NONE : (uint8_t)Random());
+      break;
+
+    case 4:
+      Flip.All();
+      break;
+
+    case 5:
+      Flip.Clear();
+      break;
+  }
+
+  TargetAnyAll();
+}
+
+/*----------------------------------------------------------------------------------*
+ * Modes, queue service, timing and the other settings                              *
+ *----------------------------------------------------------------------------------*/
+static void FuzzControl(void)
+{
+  switch(Random() % 14)
+  {
+    case 0:  Flip.Mode(QUEUE); break;
+    case 1:  Flip.Mode((Random() % 4 == 0) ? (uint8_t)Random() : DIRECT); break;
+    case 2:  Flip.Flush(); break;
+    case 3:  Flip.Step(); break;
+    case 4:  Flip.Service(Random() % 5000); break;
+    case 5:  Flip.FrameRate(Random() % 60); break;
+    case 6:  Flip.Frame(); break;
+    case 7:  Flip.Lookahead(Random() % 200); break;
+    case 8:  Flip.Priority(RandomType(), RandomModule(), Random()); break;
+    case 9:  Flip.DelayMicros(Random() % 3000); break;
+    case 10: Flip.Delay(RandomType(), RandomModule(), Random() % 3); break;
+    case 11: Flip.FlipRate(Random() % 2000, Random() % 8); break;
+    case 12: Flip.Unknown(RandomType(), RandomModule(), RandomDisc(), RandomDisc()); break;
+    case 13: Flip.ClockWait(Random() % 20000); break;
+  }
+}
+
+/*----------------------------------------------------------------------------------*
+ * Final properties - all flips done and the discs show the statuses set            *
+ * by the last Disc_*() calls                                                       *
+ *----------------------------------------------------------------------------------*/
+static void FuzzCheck(void)
+{
+  Flip.FrameRate(0);
+  Flip.Flush();
+
+  if(Flip.Pending() != 0) Fail("flips still pending after Flush()");
+
+  for(int module_position = 0; module_position < 8; module_position++)
+  {
+    for(int disc_number = 0; disc_number < ChainDiscs(module_position); disc_number++)
+    {
+      if(targetArray[module_position][disc_number] == chain_unknown) continue;
+      if(ChainDisc(module_position, disc_number) != targetArray[module_position][disc_number])
+      {
+        char message[80];
+        snprintf(message, sizeof(message), "display %d disc %d does not show the last status set", module_position, disc_number);
+        Fail(message);
+      }
+    }
+  }
+}
+
+static void FuzzBegin(void)
+{
+  Flip.Clock(VIRTUAL_CLOCK);
+  Flip.Pin(chain_en_pin, chain_ch_pin, chain_pl_pin);
+  ChainBegin(fuzz_types);
+  ChainOnPulse(ChainPulse);
+  Flip.OnFlip(FlipReported);
+  Flip.Init(fuzz_types[0], fuzz_types[1], fuzz_types[2], fuzz_types[3],
+            fuzz_types[4], fuzz_types[5], fuzz_types[6], fuzz_types[7]);
+  memset(targetArray, chain_unknown, sizeof(targetArray));
+}
+
+static void FuzzCalls(uint16_t number_calls)
+{
+  for(uint16_t call = 0; call < number_calls; call++)
+  {
+    uint8_t call_group = Random() % 8;
+
+    if(call_group < 3) FuzzDisc();
+    else if(call_group < 5) FuzzDisplay();
+    else if(call_group < 6) FuzzMatrix();
+    else FuzzControl();
+  }
+}
+
+#if defined(FLIPDISC_LIBFUZZER)
+
+/*----------------------------------------------------------------------------------*
+ * libFuzzer target - one chain with all display types, the state of the discs      *
+ * and the library carries over from input to input                                 *
+ *----------------------------------------------------------------------------------*/
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  static bool fuzz_started = false;
+
+  if(fuzz_started == false)
+  {
+    const uint8_t chainArray[8] = {D7SEG, D3X5, D4X3X3, D2X6, D1X7, D3X3, D3X4, D3X1};
+    memcpy(fuzz_types, chainArray, sizeof(fuzz_types));
+    FuzzBegin();
+    fuzz_started = true;
+  }
+
+  fuzz_data = data;
+  fuzz_size = size;
+  while(fuzz_size > 0) FuzzCalls(1);
+  fuzz_data = NULL;
+
+  FuzzCheck();
+  if(ChainErrors() > 0) abort();
+  return 0;
+}
+
+#else
+
+/*----------------------------------------------------------------------------------*
+ * One case - a random chain of up to 8 displays and a random sequence of calls     *
+ *----------------------------------------------------------------------------------*/
+static bool FuzzCase(uint32_t seed)
+{
+  fuzz_random = seed * 2654435761UL + 1;
+
+  uint8_t number_modules = 1 + Random() % 8;
+  for(int module_position = 0; module_position < 8; module_position++)
+  {
+    if(module_position >= number_modules) fuzz_types[module_position] = NONE;
+    else fuzz_types[module_position] = RandomType();
+  }
+
+  FuzzBegin();
+  FuzzCalls(400);
+  FuzzCheck();
+
+  return ChainErrors() == 0;
+}
+
+int main(int argc, char *argv[])
+{
+  uint32_t number_cases = (argc > 1) ? strtoul(argv[1], NULL, 0) : 300;
+  uint32_t first_seed = (argc > 2) ? strtoul(argv[2], NULL, 0) : 1;
+  uint32_t failed_cases = 0;
+
+  for(uint32_t seed = first_seed; seed < first_seed + number_cases; seed++)
+  {
+    fflush(stdout);
+    pid_t case_pid = fork();
+    if(case_pid == 0)
+    {
+      bool case_passed = FuzzCase(seed);
+      fflush(stdout);
+      _exit(case_passed ? 0 : 1);
+    }
+
+    int case_status = 0;
+    waitpid(case_pid, &case_status, 0);
+
+    if(!WIFEXITED(case_status) || (WEXITSTATUS(case_status) != 0))
+    {
+      printf("fuzz_test: seed %lu failed\n", (unsigned long)seed);
+      failed_cases = failed_cases + 1;
+    }
+  }
+
+  printf("fuzz_test: %lu cases, %lu failed\n", (unsigned long)number_cases, (unsigned long)failed_cases);
+  return (failed_cases == 0) ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,401 @@
+/*----------------------------------------------------------------------------------*
+ * golden_test.cpp - golden-image test of the glyph tables of the FlipDisc library. *
+ * Every entry of displayArray_7Seg, displayArray_3x5, diceArray/numbArray_3x3,     *
+ * diceArray/numbArray_4x3x3 and every printable character of charArray_7Seg and    *
+ * charArray_3x5 is displayed by the real Display_*() and Text() functions.         *
+ * The simulated chain (chain.cpp) decodes the SPI frames of the current pulses     *
+ * back into disc statuses, which are drawn as ASCII art in the layout of           *
+ * the display ("#" - "1" color, "." - "0" black) and compared with the files       *
+ * in golden/. Number() is drawn on four 3x5 displays side by side.                 *
+ * Then the known-state skip of the DIRECT mode is checked - the same symbol again  *
+ * must release no pulse - and Number() with decimals on the 7-segment display,     *
+ * which has no dot, must show nothing, and print() after Home() must start again   *
+ * from the first display. The estimates of an unknown data type must be 0.         *
+ * Usage: golden_test [--update] - --update writes the golden files instead,        *
+ * check the diff of golden/ before committing it.                                  *
+ *----------------------------------------------------------------------------------*/
+
+#include "chain.h"
+#include <stdio.h>
+#include <string>
+
+static const char golden_folder[] = "golden/";
+
+// Absolute positions of the displays in the chain
+static const uint8_t position_7seg  = 0;
+static const uint8_t position_3x5   = 1;
+static const uint8_t position_3x3   = 2;
+static const uint8_t position_4x3x3 = 3;
+static const uint8_t position_number = 4;   // Three more 3x5 displays after the 3x5 one
+
+/*
+ * Layouts of the displays - disc numbers counting from 0, row by row from the top,
+ * -1 - no disc. See the comments of the tables in FlipDisc.h and of the Display_*()
+ * functions in FlipDisc.cpp.
+ */
+static const int8_t layoutArray_7Seg[7][5] =
+{
+  { 0,  1,  2,  3,  4},
+  {19, -1, -1, -1,  5},
+  {18, -1, -1, -1,  6},
+  {17, 20, 21, 22,  7},
+  {16, -1, -1, -1,  8},
+  {15, -1, -1, -1,  9},
+  {14, 13, 12, 11, 10}
+};
+
+static const int8_t layoutArray_3x5[5][3] =
+{
+  {12, 13, 14},
+  { 9, 10, 11},
+  { 6,  7,  8},
+  { 3,  4,  5},
+  { 0,  1,  2}
+};
+
+static const int8_t layoutArray_3x3[3][3] =
+{
+  {6, 7, 8},
+  {3, 4, 5},
+  {0, 1, 2}
+};
+
+static const int8_t layoutArray_4x3x3[6][6] =
+{
+  {35, 34, 33, 26, 25, 24},
+  {32, 31, 30, 23, 22, 21},
+  {29, 28, 27, 20, 19, 18},
+  {17, 16, 15,  8,  7,  6},
+  {14, 13, 12,  5,  4,  3},
+  {11, 10,  9,  2,  1,  0}
+};
+
+/*----------------------------------------------------------------------------------*
+ * Draws the discs of one display, "?" - the disc has never been flipped            *
+ *----------------------------------------------------------------------------------*/
+static void Draw(std::string &image, const char *title, uint8_t module_position,
+                 const int8_t *layout, uint8_t rows, uint8_t columns)
+{
+  image += "=== ";
+  image += title;
+  image += "\n";
+
+  for(int row = 0; row < rows; row++)
+  {
+    for(int column = 0; column < columns; column++)
+    {
+      int8_t disc_number = layout[row * columns + column];
+      if(disc_number < 0) image += ' ';
+      else if(ChainDisc(module_position, disc_number) == chain_unknown) image += '?';
+      else image += ChainDisc(module_position, disc_number) ? '#' : '.';
+    }
+    image += "\n";
+  }
+}
+
+static std::string Render_7Seg(void)
+{
+  std::string image;
+  char title[32];
+
+  for(int symbol = 0; symbol <= 45; symbol++)
+  {
+    Flip.Display_7Seg(1, symbol);
+    snprintf(title, sizeof(title), "7seg %d", symbol);
+    Draw(image, title, position_7seg, &layoutArray_7Seg[0][0], 7, 5);
+  }
+
+  return image;
+}
+
+static std::string Render_3x5(void)
+{
+  std::string image;
+  char title[32];
+
+  for(int symbol = 0; symbol <= 67; symbol++)
+  {
+    Flip.Display_3x5(1, symbol);
+    snprintf(title, sizeof(title), "3x5 %d", symbol);
+    Draw(image, title, position_3x5, &layoutArray_3x5[0][0], 5, 3);
+  }
+
+  return image;
+}
+
+static std::string Render_3x3(uint8_t data_type)
+{
+  std::string image;
+  char title[32];
+
+  for(int symbol = 0; symbol <= 11; symbol++)
+  {
+    Flip.Display_3x3(1, symbol, data_type);
+    snprintf(title, sizeof(title), "3x3 %s %d", (data_type == DICE) ? "DICE" : "NUMB", symbol);
+    Draw(image, title, position_3x3, &layoutArray_3x3[0][0], 3, 3);
+  }
+
+  return image;
+}
+
+// The same symbol in all four sections, so the section offsets are checked too
+static std::string Render_4x3x3(uint8_t data_type)
+{
+  std::string image;
+  char title[32];
+
+  for(int symbol = 0; symbol <= 11; symbol++)
+  {
+    for(int section_number = 1; section_number <= 4; section_number++) Flip.Display_4x3x3(1, section_number, symbol, data_type);
+    snprintf(title, sizeof(title), "4x3x3 %s %d", (data_type == DICE) ? "DICE" : "NUMB", symbol);
+    Draw(image, title, position_4x3x3, &layoutArray_4x3x3[0][0], 6, 6);
+  }
+
+  return image;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Numbers shown by Number() on the four 3x5 displays (positions 1, 4, 5, 6),       *
+ * the decimal point takes its own display                                          *
+ *----------------------------------------------------------------------------------*/
+static std::string Render_Number(void)
+{
+  static const int32_t valueArray[] = {0, 5, -5, 235, -235, 1234, 12345};
+  static const uint8_t decimalsArray[] = {0, 1, 1, 1, 0, 2, 0};
+  const uint8_t positionArray[4] = {position_3x5, position_number, position_number + 1, position_number + 2};
+  std::string image;
+  char title[48];
+
+  for(size_t i = 0; i < sizeof(valueArray) / sizeof(valueArray[0]); i++)
+  {
+    Flip.Text(D3X5, 1);
+    Flip.Number(valueArray[i], decimalsArray[i]);
+
+    snprintf(title, sizeof(title), "number %d decimals %d", valueArray[i], decimalsArray[i]);
+    image += "=== ";
+    image += title;
+    image += "\n";
+
+    for(int row = 0; row < 5; row++)
+    {
+      for(int display = 0; display < 4; display++)
+      {
+        if(display > 0) image += ' ';
+        for(int column = 0; column < 3; column++)
+        {
+          uint8_t disc_status = ChainDisc(positionArray[display], layoutArray_3x5[row][column]);
+          if(disc_status == chain_unknown) image += '?';
+          else image += disc_status ? '#' : '.';
+        }
+      }
+      image += "\n";
+    }
+  }
+
+  return image;
+}
+
+// Printable ASCII characters shown by Text()
+static std::string Render_Text(uint8_t module_type)
+{
+  std::string image;
+  char title[32];
+
+  for(int character = 0x20; character < 0x7F; character++)
+  {
+    Flip.Text(module_type, 1);
+    Flip.write(character);
+
+    if(module_type == D7SEG)
+    {
+      snprintf(title, sizeof(title), "text 7seg '%c'", character);
+      Draw(image, title, position_7seg, &layoutArray_7Seg[0][0], 7, 5);
+    }
+    else
+    {
+      snprintf(title, sizeof(title), "text 3x5 '%c'", character);
+      Draw(image, title, position_3x5, &layoutArray_3x5[0][0], 5, 3);
+    }
+  }
+
+  return image;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Compares the image with the golden file, or writes the golden file               *
+ *----------------------------------------------------------------------------------*/
+static bool Golden(const char *file_name, const std::string &image, bool update)
+{
+  std::string path = std::string(golden_folder) + file_name;
+
+  if(update == true)
+  {
+    FILE *file = fopen(path.c_str(), "wb");
+    if(file == NULL)
+    {
+      printf("golden_test: cannot write %s\n", path.c_str());
+      return 0;
+    }
+    fwrite(image.data(), 1, image.size(), file);
+    fclose(file);
+    return 1;
+  }
+
+  std::string golden;
+  FILE *file = fopen(path.c_str(), "rb");
+  if(file == NULL)
+  {
+    printf("golden_test: cannot read %s\n", path.c_str());
+    return 0;
+  }
+  char buffer[512];
+  size_t length;
+  while((length = fread(buffer, 1, sizeof(buffer), file)) > 0) golden.append(buffer, length);
+  fclose(file);
+
+  if(golden == image) return 1;
+
+  // Show the first glyph which differs
+  size_t difference = 0;
+  while((difference < golden.size()) && (difference < image.size()) && (golden[difference] == image[difference])) difference++;
+  size_t glyph_start = image.rfind("===", difference);
+  if(glyph_start == std::string::npos) glyph_start = 0;
+  size_t glyph_end = image.find("===", glyph_start + 3);
+
+  printf("golden_test: %s differs from the golden file, first at:\n%s", path.c_str(),
+         image.substr(glyph_start, glyph_end - glyph_start).c_str());
+  return 0;
+}
+
+/*----------------------------------------------------------------------------------*
+ * The known-state skip in the DIRECT mode - the discs which already show           *
+ * the symbol are not pulsed again, until Unknown() or Test()                       *
+ *----------------------------------------------------------------------------------*/
+static bool KnownSkip(void)
+{
+  bool passed = true;
+
+  Flip.Display_7Seg(1, 8);
+  uint32_t first_pulses = ChainPulses();
+  Flip.Display_7Seg(1, 8);
+  if(ChainPulses() != first_pulses)
+  {
+    printf("golden_test: the same symbol pulsed again in the DIRECT mode\n");
+    passed = false;
+  }
+
+  Flip.Unknown(D7SEG, 1);
+  Flip.Display_7Seg(1, 8);
+  if(ChainPulses() != first_pulses + 23)
+  {
+    printf("golden_test: the discs marked by Unknown() not pulsed\n");
+    passed = false;
+  }
+
+  return passed;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Number() with decimals on the 7-segment display - no dot, so nothing is shown    *
+ *----------------------------------------------------------------------------------*/
+static bool NumberNoDot(void)
+{
+  bool passed = true;
+
+  Flip.Text(D7SEG, 1);
+  uint32_t first_pulses = ChainPulses();
+  if((Flip.Number(5, 1) == true) || (ChainPulses() != first_pulses))
+  {
+    printf("golden_test: Number() with decimals shown on the 7-segment display\n");
+    passed = false;
+  }
+
+  if(Flip.Number(5) == false)
+  {
+    printf("golden_test: Number() without decimals not shown on the 7-segment display\n");
+    passed = false;
+  }
+
+  return passed;
+}
+
+/*----------------------------------------------------------------------------------*
+ * print() continues after the last display until Home() moves the cursor back      *
+ *----------------------------------------------------------------------------------*/
+static bool Shows_7Seg(uint8_t symbol)
+{
+  for(int disc_number = 0; disc_number < 23; disc_number++)
+  {
+    bool disc_status = (pgm_read_byte(&displayArray_7Seg[symbol][disc_number / 8]) >> (disc_number % 8)) & 1;
+    if(ChainDisc(position_7seg, disc_number) != disc_status) return 0;
+  }
+  return 1;
+}
+
+static bool PrintHome(void)
+{
+  bool passed = true;
+
+  Flip.Text(D7SEG, 1);
+  Flip.print(1);
+  Flip.print(2);
+  if(Shows_7Seg(1) == false)
+  {
+    printf("golden_test: print() after the last display not skipped\n");
+    passed = false;
+  }
+
+  Flip.Home();
+  Flip.print(2);
+  if(Shows_7Seg(2) == false)
+  {
+    printf("golden_test: print() after Home() not shown on the first display\n");
+    passed = false;
+  }
+
+  return passed;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Estimate_3x3() and Estimate_4x3x3() of a data type other than DICE and NUMB      *
+ *----------------------------------------------------------------------------------*/
+static bool EstimateDataType(void)
+{
+  Flip.Unknown();
+  if((Flip.Estimate_3x3(1, 5, 0) == 0) && (Flip.Estimate_4x3x3(1, 1, 5, 0) == 0)) return 1;
+
+  printf("golden_test: the estimate of an unknown data type is not 0\n");
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  bool update = (argc > 1) && (std::string(argv[1]) == "--update");
+  const uint8_t chainArray[8] = {D7SEG, D3X5, D3X3, D4X3X3, D3X5, D3X5, D3X5, NONE};
+
+  Flip.Clock(VIRTUAL_CLOCK);
+  Flip.Pin(chain_en_pin, chain_ch_pin, chain_pl_pin);
+  ChainBegin(chainArray);
+  Flip.Init(D7SEG, D3X5, D3X3, D4X3X3, D3X5, D3X5, D3X5);
+
+  bool passed = true;
+  passed &= Golden("7seg.txt", Render_7Seg(), update);
+  passed &= Golden("3x5.txt", Render_3x5(), update);
+  passed &= Golden("3x3_dice.txt", Render_3x3(DICE), update);
+  passed &= Golden("3x3_numb.txt", Render_3x3(NUMB), update);
+  passed &= Golden("4x3x3_dice.txt", Render_4x3x3(DICE), update);
+  passed &= Golden("4x3x3_numb.txt", Render_4x3x3(NUMB), update);
+  passed &= Golden("text_7seg.txt", Render_Text(D7SEG), update);
+  passed &= Golden("text_3x5.txt", Render_Text(D3X5), update);
+  passed &= Golden("number_3x5.txt", Render_Number(), update);
+
+  if(update == false) passed &= KnownSkip();
+  if(update == false) passed &= NumberNoDot();
+  if(update == false) passed &= PrintHome();
+  if(update == false) passed &= EstimateDataType();
+
+  if(ChainErrors() > 0) passed = false;
+
+  printf("golden_test: %s%s\n", update ? "golden files written, " : "", passed ? "passed" : "FAILED");
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+/*----------------------------------------------------------------------------------*
+ * Arduino.cpp - host stub of the Arduino core for the tests of the FlipDisc        *
+ * library. The time only advances when the library reads or waits for it,         *
+ * the tests use Flip.Clock(VIRTUAL_CLOCK) anyway.                                  *
+ *----------------------------------------------------------------------------------*/
+
+#include <Arduino.h>
+#include <stdio.h>
+
+static unsigned long long host_us = 0;
+
+unsigned long millis(void)
+{
+  host_us = host_us + 1;
+  return (unsigned long)(host_us / 1000);
+}
+
+unsigned long micros(void)
+{
+  host_us = host_us + 1;
+  return (unsigned long)host_us;
+}
+
+void delay(unsigned long ms)
+{
+  host_us = host_us + ms * 1000ULL;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  host_us = host_us + us;
+}
+
+void pinMode(uint8_t, uint8_t)
+{
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+  while(size-- > 0) n = n + write(*buffer++);
+  return n;
+}
+
+size_t Print::write(const char *text)
+{
+  return write((const uint8_t *)text, strlen(text));
+}
+
+size_t Print::print(const __FlashStringHelper *text)
+{
+  return write((const char *)text);
+}
+
+size_t Print::print(const char *text)
+{
+  return write(text);
+}
+
+size_t Print::print(char character)
+{
+  return write((uint8_t)character);
+}
+
+size_t Print::print(unsigned char number, int base)
+{
+  return print((unsigned long)number, base);
+}
+
+size_t Print::print(int number, int base)
+{
+  return print((long)number, base);
+}
+
+size_t Print::print(unsigned int number, int base)
+{
+  return print((unsigned long)number, base);
+}
+
+size_t Print::print(long number, int base)
+{
+  if((base == DEC) && (number < 0)) return print('-') + print((unsigned long)(-number), base);
+  return print((unsigned long)number, base);
+}
+
+size_t Print::print(unsigned long number, int base)
+{
+  char text[24];
+  snprintf(text, sizeof(text), (base == HEX) ? "%lX" : "%lu", number);
+  return write(text);
+}
+
+size_t Print::print(double number, int digits)
+{
+  char text[32];
+  snprintf(text, sizeof(text), "%.*f", digits, number);
+  return write(text);
+}
+
+size_t Print::println(void)
+{
+  return write("\r\n");
+}
@@ -0,0 +1,39 @@
+/*----------------------------------------------------------------------------------*
+ * Arduino.h - host stub of the Arduino core for the tests of the FlipDisc library. *
+ * Only the part of the Arduino API used by the library is declared.                *
+ * The pins and the SPI bus are simulated by the controller chain in chain.cpp,     *
+ * the time functions are implemented in Arduino.cpp.                               *
+ *----------------------------------------------------------------------------------*/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+
+#define HIGH   1
+#define LOW    0
+#define OUTPUT 1
+
+typedef uint8_t byte;
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+
+#include "Print.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include "freertos.h"
+#endif
+
+#endif
@@ -0,0 +1,32 @@
+/*----------------------------------------------------------------------------------*
+ * EEPROM.cpp - host stub of the emulated EEPROM, see EEPROM.h.                     *
+ *----------------------------------------------------------------------------------*/
+
+#include <EEPROM.h>
+#include <string.h>
+
+EEPROMClass EEPROM;
+
+EEPROMClass::EEPROMClass(void)
+{
+  memset(eepromArray, 0xFF, sizeof(eepromArray));
+}
+
+void EEPROMClass::begin(uint16_t)
+{
+}
+
+uint8_t EEPROMClass::read(int address)
+{
+  return eepromArray[address % sizeof(eepromArray)];
+}
+
+void EEPROMClass::write(int address, uint8_t value)
+{
+  eepromArray[address % sizeof(eepromArray)] = value;
+}
+
+bool EEPROMClass::commit(void)
+{
+  return 1;
+}
@@ -0,0 +1,26 @@
+/*----------------------------------------------------------------------------------*
+ * EEPROM.h - host stub of the EEPROM library of the ESP32/ESP8266 core (emulated   *
+ * EEPROM with begin() and commit()). The memory is erased (0xFF) at start.         *
+ *----------------------------------------------------------------------------------*/
+
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include <stdint.h>
+
+class EEPROMClass
+{
+  public:
+    EEPROMClass(void);
+    void begin(uint16_t size);
+    uint8_t read(int address);
+    void write(int address, uint8_t value);
+    bool commit(void);
+
+  private:
+    uint8_t eepromArray[4096];
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
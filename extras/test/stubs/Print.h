@@ -0,0 +1,41 @@
+/*----------------------------------------------------------------------------------*
+ * Print.h - host stub of the Arduino Print class for the tests of the FlipDisc     *
+ * library. Only the overloads used by the library and the tests are declared.      *
+ *----------------------------------------------------------------------------------*/
+
+#ifndef Print_h
+#define Print_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define DEC 10
+#define HEX 16
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+class Print
+{
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t data) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *text);
+
+    size_t print(const __FlashStringHelper *text);
+    size_t print(const char *text);
+    size_t print(char character);
+    size_t print(unsigned char number, int base = DEC);
+    size_t print(int number, int base = DEC);
+    size_t print(unsigned int number, int base = DEC);
+    size_t print(long number, int base = DEC);
+    size_t print(unsigned long number, int base = DEC);
+    size_t print(double number, int digits = 2);
+
+    size_t println(void);
+    template <typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+    template <typename T> size_t println(T value, int base) { size_t n = print(value, base); return n + println(); }
+};
+
+#endif
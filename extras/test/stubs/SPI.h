@@ -0,0 +1,20 @@
+/*----------------------------------------------------------------------------------*
+ * SPI.h - host stub of the Arduino SPI library for the tests of the FlipDisc       *
+ * library. The bytes are shifted into the simulated controller chain, chain.cpp.   *
+ *----------------------------------------------------------------------------------*/
+
+#ifndef SPI_h
+#define SPI_h
+
+#include <stdint.h>
+
+class SPIClass
+{
+  public:
+    void begin(void);
+    uint8_t transfer(uint8_t data);
+};
+
+extern SPIClass SPI;
+
+#endif
@@ -0,0 +1,60 @@
+/*----------------------------------------------------------------------------------*
+ * freertos.cpp - host stub of FreeRTOS, see freertos.h. A task is a detached       *
+ * std::thread which runs until the test process exits. The handle of a task is     *
+ * a thread_local address, so every thread has its own handle.                      *
+ *----------------------------------------------------------------------------------*/
+
+#include <freertos.h>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+
+static thread_local uint8_t task_self;
+
+// Handshake between xTaskCreatePinnedToCore() and the new thread
+typedef struct
+{
+  std::mutex lock;
+  std::condition_variable signal;
+  TaskHandle_t task_handle;
+  bool handle_saved;
+} TaskStart;
+
+int xTaskCreatePinnedToCore(void (*task_function)(void *), const char *, uint32_t,
+                            void *task_parameters, uint32_t, TaskHandle_t *task_handle, int)
+{
+  std::shared_ptr<TaskStart> task_start = std::make_shared<TaskStart>();
+  task_start->task_handle = NULL;
+  task_start->handle_saved = false;
+
+  // As in FreeRTOS, *task_handle is written before the task runs
+  std::thread([task_start, task_function, task_parameters]()
+  {
+    {
+      std::unique_lock<std::mutex> guard(task_start->lock);
+      task_start->task_handle = &task_self;
+      task_start->signal.notify_all();
+      task_start->signal.wait(guard, [&]() { return task_start->handle_saved; });
+    }
+    task_function(task_parameters);
+  }).detach();
+
+  std::unique_lock<std::mutex> guard(task_start->lock);
+  task_start->signal.wait(guard, [&]() { return task_start->task_handle != NULL; });
+  if(task_handle != NULL) *task_handle = task_start->task_handle;
+  task_start->handle_saved = true;
+  task_start->signal.notify_all();
+
+  return 1;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+  return &task_self;
+}
+
+void vTaskDelay(uint32_t ticks)
+{
+  std::this_thread::sleep_for(std::chrono::microseconds(10 * ticks));
+}
@@ -0,0 +1,30 @@
+/*----------------------------------------------------------------------------------*
+ * freertos.h - host stub of the part of FreeRTOS used by the ESP32 driver task     *
+ * of the FlipDisc library (Driver()). Included by Arduino.h when the test is       *
+ * built with ARDUINO_ARCH_ESP32. The tasks are std::threads, the spinlock          *
+ * of the critical sections is a std::mutex - ThreadSanitizer checks both.          *
+ *----------------------------------------------------------------------------------*/
+
+#ifndef freertos_h
+#define freertos_h
+
+#include <stdint.h>
+#include <mutex>
+
+typedef void *TaskHandle_t;
+
+typedef struct
+{
+  std::mutex lock;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {}
+#define portENTER_CRITICAL(mux) ((mux)->lock.lock())
+#define portEXIT_CRITICAL(mux)  ((mux)->lock.unlock())
+
+int xTaskCreatePinnedToCore(void (*task_function)(void *), const char *task_name, uint32_t stack_size,
+                            void *task_parameters, uint32_t task_priority, TaskHandle_t *task_handle, int task_core);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+void vTaskDelay(uint32_t ticks);
+
+#endif
@@ -0,0 +1,230 @@
+/*----------------------------------------------------------------------------------*
+ * task_test.cpp - interleaving test of the FlipTask handles of the FlipDisc        *
+ * library on the virtual clock. Two 7-segment and two 3x5 displays get random      *
+ * symbols in the QUEUE mode, with random delay effects and in half of the cases    *
+ * with FrameRate(), while the queue is serviced by random Step() and Service()     *
+ * calls and the virtual time runs on between them, so the updates of               *
+ * the displays overlap in random order. The properties:                            *
+ * -> Progress() of a handle is 0-100 and never goes back                           *
+ * -> Done() is 1 exactly when Progress() is 100, and then the display shows        *
+ *    the symbol of the handle                                                      *
+ * -> OnDone() is called once, right after the last flip of its display - before    *
+ *    the next pulse of any other display - or at once if the update is done        *
+ * -> OnDone(NULL) cancels the waiting callback, also on a done update and on       *
+ *    a handle without a display                                                    *
+ * -> after Flush() every handle is done and every callback has been called         *
+ * Each case runs in its own process - Init() can be called only once.              *
+ * Usage: task_test [number_cases] [first_seed]                                     *
+ *----------------------------------------------------------------------------------*/
+
+#include "chain.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static const uint8_t task_displays = 4;     // Positions 0-3 of the chain
+static const uint16_t task_actions = 400;   // Random calls of each case
+
+static const uint8_t taskTypeArray[task_displays] = {D7SEG, D3X5, D7SEG, D3X5};
+static const uint8_t taskNumberArray[task_displays] = {1, 1, 2, 2};
+
+static FlipTask taskArray[task_displays];
+static uint8_t taskSymbolArray[task_displays];   // The symbol of the newest handle
+static uint8_t taskProgressArray[task_displays]; // The last Progress() of the newest handle
+static bool taskWaitArray[task_displays];        // OnDone() set, not called yet
+static uint32_t task_random = 1;                 // xorshift32 state
+
+static uint32_t Random(void)
+{
+  task_random ^= task_random << 13;
+  task_random ^= task_random >> 17;
+  task_random ^= task_random << 5;
+  return task_random;
+}
+
+/*----------------------------------------------------------------------------------*
+ * 1 - the display shows the symbol of displayArray_7Seg or displayArray_3x5        *
+ *----------------------------------------------------------------------------------*/
+static bool TaskShows(uint8_t display)
+{
+  uint8_t symbol = taskSymbolArray[display];
+  uint8_t number_discs = (taskTypeArray[display] == D7SEG) ? 23 : 15;
+
+  for(int disc_number = 0; disc_number < number_discs; disc_number++)
+  {
+    uint8_t symbol_byte;
+    if(taskTypeArray[display] == D7SEG) symbol_byte = pgm_read_byte(&displayArray_7Seg[symbol][disc_number / 8]);
+    else symbol_byte = pgm_read_byte(&displayArray_3x5[symbol][disc_number / 8]);
+
+    if(ChainDisc(display, disc_number) != ((symbol_byte >> (disc_number % 8)) & 1)) return 0;
+  }
+  return 1;
+}
+
+/*----------------------------------------------------------------------------------*
+ * OnDone() callbacks - one function per display, as the callback has no argument   *
+ *----------------------------------------------------------------------------------*/
+template<int display> static void TaskOnDone(void)
+{
+  if(taskWaitArray[display] == false) ChainFail("OnDone() called twice or not set");
+  if(taskArray[display].Done() == false) ChainFail("OnDone() called before Done()");
+  if(TaskShows(display) == false) ChainFail("OnDone() called before the symbol is shown");
+  taskWaitArray[display] = false;
+}
+
+static void (*const taskCallbackArray[task_displays])(void) =
+{
+  TaskOnDone<0>, TaskOnDone<1>, TaskOnDone<2>, TaskOnDone<3>
+};
+
+/*----------------------------------------------------------------------------------*
+ * Every pulse - a display done before this pulse must have had its callback        *
+ *----------------------------------------------------------------------------------*/
+static void TaskPulse(uint8_t module_position, uint8_t, bool)
+{
+  for(int display = 0; display < task_displays; display++)
+  {
+    if(display == module_position) continue;
+    if((taskWaitArray[display] == true) && (taskArray[display].Done() == true)) ChainFail("OnDone() called late");
+  }
+}
+
+/*----------------------------------------------------------------------------------*
+ * The properties of the handles between the calls. An update done by a display     *
+ * call (the discs already show the symbol) calls OnDone() only at the next         *
+ * Step(), Service() or Flush() -> serviced - the queue has just been serviced      *
+ *----------------------------------------------------------------------------------*/
+static void TaskCheck(bool serviced)
+{
+  for(int display = 0; display < task_displays; display++)
+  {
+    uint8_t progress = taskArray[display].Progress();
+    bool done = taskArray[display].Done();
+
+    if(progress > 100) ChainFail("Progress() above 100");
+    if(progress < taskProgressArray[display]) ChainFail("Progress() went back");
+    if(done != (progress == 100)) ChainFail("Done() does not match Progress()");
+    if((done == true) && (TaskShows(display) == false)) ChainFail("Done() before the symbol is shown");
+    if((serviced == true) && (done == true) && (taskWaitArray[display] == true)) ChainFail("OnDone() not called after Done()");
+
+    taskProgressArray[display] = progress;
+  }
+}
+
+static bool TaskCase(uint32_t seed)
+{
+  const uint8_t chainArray[8] = {D7SEG, D3X5, D7SEG, D3X5, NONE, NONE, NONE, NONE};
+  bool frame_mode = (seed % 2 == 1);
+
+  task_random = seed * 2654435761u + 1;
+
+  Flip.Clock(VIRTUAL_CLOCK);
+  Flip.Pin(chain_en_pin, chain_ch_pin, chain_pl_pin);
+  ChainBegin(chainArray);
+  ChainOnPulse(TaskPulse);
+  Flip.Init(D7SEG, D3X5, D7SEG, D3X5);
+  Flip.Mode(QUEUE);
+  if(frame_mode == true) Flip.FrameRate(25);
+
+  // A handle without a display is always done - OnDone(NULL) must not call anything
+  FlipTask().OnDone(NULL);
+
+  for(int display = 0; display < task_displays; display++)
+  {
+    Flip.Delay(taskTypeArray[display], taskNumberArray[display], Random() % 4);
+
+    // Start with a known symbol, so every handle has a symbol to check
+    taskSymbolArray[display] = 0;
+    if(taskTypeArray[display] == D7SEG) taskArray[display] = Flip.Display_7Seg(taskNumberArray[display], 0);
+    else taskArray[display] = Flip.Display_3x5(taskNumberArray[display], 0);
+    taskProgressArray[display] = 0;
+  }
+
+  for(int action_number = 0; action_number < task_actions; action_number++)
+  {
+    uint8_t display = Random() % task_displays;
+    uint8_t action = Random() % 7;
+
+    switch(action)
+    {
+      case 0:
+      case 1:
+        // A newer update of the display replaces the handle
+        if(taskTypeArray[display] == D7SEG)
+        {
+          taskSymbolArray[display] = Random() % 46;
+          taskArray[display] = Flip.Display_7Seg(taskNumberArray[display], taskSymbolArray[display]);
+        }
+        else
+        {
+          taskSymbolArray[display] = Random() % 68;
+          taskArray[display] = Flip.Display_3x5(taskNumberArray[display], taskSymbolArray[display]);
+        }
+        taskProgressArray[display] = 0;
+        if(frame_mode == true) Flip.Frame();
+        break;
+
+      case 2:
+        // Called at once if the update is already done
+        taskWaitArray[display] = true;
+        taskArray[display].OnDone(taskCallbackArray[display]);
+        break;
+
+      case 3:
+        Flip.Step();
+        break;
+
+      case 4:
+        // The waiting callback is cancelled, nothing is called
+        taskWaitArray[display] = false;
+        taskArray[display].OnDone(NULL);
+        break;
+
+      default:
+        Flip.Service(Random() % 8000);
+        Flip.ClockWait(Random() % 5000);
+        break;
+    }
+
+    TaskCheck((action == 3) || (action > 4));
+  }
+
+  Flip.FrameRate(0);
+  Flip.Flush();
+  TaskCheck(true);
+
+  for(int display = 0; display < task_displays; display++)
+  {
+    if(taskArray[display].Done() == false) ChainFail("not done after Flush()");
+    if(taskWaitArray[display] == true) ChainFail("OnDone() not called after Flush()");
+  }
+
+  return (ChainErrors() == 0);
+}
+
+int main(int argc, char *argv[])
+{
+  uint32_t number_cases = (argc > 1) ? strtoul(argv[1], NULL, 0) : 200;
+  uint32_t first_seed = (argc > 2) ? strtoul(argv[2], NULL, 0) : 1;
+  uint32_t failed_cases = 0;
+
+  for(uint32_t seed = first_seed; seed < first_seed + number_cases; seed++)
+  {
+    pid_t case_process = fork();
+    if(case_process == 0)
+    {
+      bool passed = TaskCase(seed);
+      if(passed == false) printf("task_test: seed %u FAILED\n", seed);
+      fflush(stdout);
+      _exit(passed ? 0 : 1);
+    }
+
+    int case_status = 0;
+    waitpid(case_process, &case_status, 0);
+    if((WIFEXITED(case_status) == 0) || (WEXITSTATUS(case_status) != 0)) failed_cases++;
+  }
+
+  printf("task_test: %u cases, %u failed\n", number_cases, failed_cases);
+  return (failed_cases == 0) ? 0 : 1;
+}
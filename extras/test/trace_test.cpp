@@ -0,0 +1,339 @@
+/*----------------------------------------------------------------------------------*
+ * trace_test.cpp - replayer of the traces of the FlipDisc library and its          *
+ * round-trip test.                                                                 *
+ * The replayer reads the text printed by TraceDump() and plays the pin edges and   *
+ * SPI bytes into the simulated chain (chain.cpp), which decodes the current        *
+ * pulses and checks them as for the live library. A trace copied from the serial   *
+ * monitor of a real controller can be replayed on the PC:                          *
+ *   trace_test --replay trace.txt D7SEG D7SEG D3X5                                 *
+ * prints every decoded pulse with its time and the chain errors. If the oldest     *
+ * records have been overwritten, the replay starts at the first complete frame.    *
+ * The round-trip test (without --replay) runs random updates with the trace        *
+ * recorder enabled on the virtual clock, replays the dump into a new chain and     *
+ * checks that the replay decodes the same pulses (display, disc, status) at        *
+ * the same times as the live run, and that every disc ends in the same status.     *
+ * Usage: trace_test [number_cases] [first_seed]                                    *
+ *----------------------------------------------------------------------------------*/
+
+#include "chain.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <string>
+#include <vector>
+
+static const uint16_t trace_records = 60000;   // Large enough for a whole case
+static const uint16_t trace_actions = 60;      // Random calls of each case
+
+typedef struct
+{
+  uint32_t time;
+  uint8_t module_position;
+  uint8_t disc_number;
+  bool disc_status;
+} TracePulse;
+
+static std::vector<TracePulse> pulseArray;     // Pulses decoded by the chain
+static uint32_t pulse_time = 0;                // Time of the current event
+
+static void TraceOnPulse(uint8_t module_position, uint8_t disc_number, bool disc_status)
+{
+  TracePulse trace_pulse = {pulse_time, module_position, disc_number, disc_status};
+  pulseArray.push_back(trace_pulse);
+}
+
+/*----------------------------------------------------------------------------------*
+ * Print object collecting the output of TraceDump()                                *
+ *----------------------------------------------------------------------------------*/
+class TraceText : public Print
+{
+  public:
+    std::string text;
+    size_t write(uint8_t character)
+    {
+      text += (char)character;
+      return 1;
+    }
+};
+
+/*----------------------------------------------------------------------------------*
+ * Plays the trace into the chain, which must have been built by ChainBegin().      *
+ * The pulses are collected in pulseArray with the times of the trace.              *
+ * Returns 0 if the text is not a trace.                                            *
+ *----------------------------------------------------------------------------------*/
+static bool TraceReplay(const std::string &trace_text)
+{
+  unsigned long trace_count = 0;
+  unsigned long trace_lost = 0;
+  bool frame_started = false;
+  size_t line_start = 0;
+
+  pulseArray.clear();
+
+  while(line_start < trace_text.size())
+  {
+    size_t line_end = trace_text.find('\n', line_start);
+    if(line_end == std::string::npos) line_end = trace_text.size();
+    std::string line = trace_text.substr(line_start, line_end - line_start);
+    line_start = line_end + 1;
+
+    if((line.size() > 0) && (line[line.size() - 1] == '\r')) line.erase(line.size() - 1);
+    if(line.size() == 0) continue;
+
+    if(sscanf(line.c_str(), "trace %lu lost %lu", &trace_count, &trace_lost) == 2) continue;
+
+    unsigned long event_time = 0;
+    char signal[4] = "";
+    unsigned int data = 0;
+    if(sscanf(line.c_str(), "%lu,%3[A-Z],%i", &event_time, signal, &data) != 3)
+    {
+      printf("trace_test: not a trace line: %s\n", line.c_str());
+      return 0;
+    }
+
+    pulse_time = event_time;
+
+    // The frame latched before the first record is unknown - wait for a new frame
+    if((trace_lost > 0) && (frame_started == false))
+    {
+      if((strcmp(signal, "EN") != 0) || (data != LOW)) continue;
+      frame_started = true;
+    }
+
+    if(strcmp(signal, "EN") == 0) ChainPin(chain_en_pin, data);
+    else if(strcmp(signal, "CH") == 0) ChainPin(chain_ch_pin, data);
+    else if(strcmp(signal, "PL") == 0) ChainPin(chain_pl_pin, data);
+    else if(strcmp(signal, "SPI") == 0) ChainSpi(data);
+    else
+    {
+      printf("trace_test: unknown signal %s\n", signal);
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/*----------------------------------------------------------------------------------*
+ * trace_test --replay trace.txt D7SEG ... - replays a recorded trace               *
+ *----------------------------------------------------------------------------------*/
+static int TraceReplayFile(int argc, char *argv[])
+{
+  static const char *typeNameArray[] = {"D7SEG", "D2X1", "D3X1", "D1X3", "D1X7", "D2X6", "D3X3", "D3X4", "D3X5", "D4X3X3", "NONE"};
+  static const uint8_t typeArray[] = {D7SEG, D2X1, D3X1, D1X3, D1X7, D2X6, D3X3, D3X4, D3X5, D4X3X3, NONE};
+  uint8_t chainArray[8] = {NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE};
+
+  if((argc < 4) || (argc > 11))
+  {
+    printf("usage: trace_test --replay trace.txt D7SEG [D3X5 ...] - the displays in the order of Init()\n");
+    return 2;
+  }
+
+  for(int module_position = 0; module_position < argc - 3; module_position++)
+  {
+    bool type_found = false;
+    for(size_t i = 0; i < sizeof(typeArray); i++)
+    {
+      if(strcmp(argv[module_position + 3], typeNameArray[i]) != 0) continue;
+      chainArray[module_position] = typeArray[i];
+      type_found = true;
+    }
+
+    if(type_found == false)
+    {
+      printf("trace_test: unknown display %s\n", argv[module_position + 3]);
+      return 2;
+    }
+  }
+
+  FILE *file = fopen(argv[2], "rb");
+  if(file == NULL)
+  {
+    printf("trace_test: cannot read %s\n", argv[2]);
+    return 2;
+  }
+
+  std::string trace_text;
+  char buffer[512];
+  size_t length;
+  while((length = fread(buffer, 1, sizeof(buffer), file)) > 0) trace_text.append(buffer, length);
+  fclose(file);
+
+  ChainBegin(chainArray);
+  ChainOnPulse(TraceOnPulse);
+  if(TraceReplay(trace_text) == false) return 2;
+
+  // time in us, absolute display position 0-7, disc number counting from 0, status
+  for(size_t i = 0; i < pulseArray.size(); i++)
+  {
+    printf("%lu,%u,%u,%u\n", (unsigned long)pulseArray[i].time, pulseArray[i].module_position,
+           pulseArray[i].disc_number, pulseArray[i].disc_status);
+  }
+
+  printf("trace_test: %lu pulses, %lu errors\n", (unsigned long)ChainPulses(), (unsigned long)ChainErrors());
+  return (ChainErrors() == 0) ? 0 : 1;
+}
+
+/*----------------------------------------------------------------------------------*
+ * One round-trip case. The virtual clock only moves when the library waits,        *
+ * so the time of a live pulse is the time of its PL record.                        *
+ *----------------------------------------------------------------------------------*/
+static uint32_t trace_random = 1;   // xorshift32 state
+
+static uint32_t Random(void)
+{
+  trace_random ^= trace_random << 13;
+  trace_random ^= trace_random >> 17;
+  trace_random ^= trace_random << 5;
+  return trace_random;
+}
+
+static uint32_t idle_time = 0;      // Time of the waits since the last live pulse
+
+static void TraceLivePulse(uint8_t module_position, uint8_t disc_number, bool disc_status)
+{
+  idle_time = 0;
+  pulse_time = Flip.ClockMicros();
+  TraceOnPulse(module_position, disc_number, disc_status);
+}
+
+static bool TraceCase(uint32_t seed)
+{
+  const uint8_t chainArray[8] = {D7SEG, D3X5, D2X6, D4X3X3, NONE, NONE, NONE, NONE};
+  uint8_t discArray[8][36];
+
+  trace_random = seed * 2654435761u + 1;
+
+  Flip.Clock(VIRTUAL_CLOCK);
+  Flip.Pin(chain_en_pin, chain_ch_pin, chain_pl_pin);
+  ChainBegin(chainArray);
+  Flip.Init(D7SEG, D3X5, D2X6, D4X3X3);
+  if(seed % 2 == 1) Flip.Mode(QUEUE);
+
+  // The live run - every pulse with the time of the virtual clock
+  ChainOnPulse(TraceLivePulse);
+  if(Flip.TraceBegin(trace_records) == false)
+  {
+    ChainFail("no RAM for the trace");
+    return 0;
+  }
+
+  for(int action_number = 0; action_number < trace_actions; action_number++)
+  {
+    switch(Random() % 5)
+    {
+      case 0:
+        Flip.Display_7Seg(1, Random() % 46);
+        break;
+
+      case 1:
+        Flip.Display_3x5(1, Random() % 68);
+        break;
+
+      case 2:
+        Flip.Disc_2x6(1, Random() % 12 + 1, Random() % 2);
+        break;
+
+      case 3:
+        Flip.Display_4x3x3(1, Random() % 4 + 1, Random() % 12, (Random() % 2) ? DICE : NUMB);
+        break;
+
+      default:
+      {
+        Flip.Service(Random() % 20000);
+        
+        // The dump clamps longer times between two records to 65535 us
+        uint32_t wait_time = Random() % 30000;
+        if(idle_time + wait_time > 60000) break;
+        Flip.ClockWait(wait_time);
+        idle_time = idle_time + wait_time;
+        break;
+      }
+    }
+  }
+  Flip.Flush();
+
+  std::vector<TracePulse> liveArray = pulseArray;
+  memset(discArray, chain_unknown, sizeof(discArray));
+  for(int module_position = 0; module_position < 4; module_position++)
+  {
+    for(int disc_number = 0; disc_number < ChainDiscs(module_position); disc_number++)
+    {
+      discArray[module_position][disc_number] = ChainDisc(module_position, disc_number);
+    }
+  }
+  uint32_t live_errors = ChainErrors();
+
+  // The replay - a new chain, all discs unknown
+  TraceText trace_text;
+  Flip.TraceDump(trace_text);
+
+  ChainBegin(chainArray);
+  ChainOnPulse(TraceOnPulse);
+  if(TraceReplay(trace_text.text) == false) return 0;
+
+  if(pulseArray.size() != liveArray.size())
+  {
+    printf("  trace: %lu live pulses, %lu replayed\n", (unsigned long)liveArray.size(), (unsigned long)pulseArray.size());
+    return 0;
+  }
+
+  for(size_t i = 0; i < pulseArray.size(); i++)
+  {
+    // The dump counts the time from its first record - compare the times from the first pulse
+    uint32_t first_time = pulseArray[0].time;
+    uint32_t live_first_time = liveArray[0].time;
+
+    if((pulseArray[i].module_position != liveArray[i].module_position) ||
+       (pulseArray[i].disc_number != liveArray[i].disc_number) ||
+       (pulseArray[i].disc_status != liveArray[i].disc_status) ||
+       (pulseArray[i].time - first_time != liveArray[i].time - live_first_time))
+    {
+      printf("  trace: pulse %lu replayed as %u,%u,%u at %lu us, live %u,%u,%u at %lu us\n", (unsigned long)i,
+             pulseArray[i].module_position, pulseArray[i].disc_number, pulseArray[i].disc_status,
+             (unsigned long)(pulseArray[i].time - first_time), liveArray[i].module_position, liveArray[i].disc_number,
+             liveArray[i].disc_status, (unsigned long)(liveArray[i].time - live_first_time));
+      return 0;
+    }
+  }
+
+  for(int module_position = 0; module_position < 4; module_position++)
+  {
+    for(int disc_number = 0; disc_number < ChainDiscs(module_position); disc_number++)
+    {
+      if(ChainDisc(module_position, disc_number) != discArray[module_position][disc_number]) ChainFail("replayed disc differs");
+    }
+  }
+
+  return (live_errors == 0) && (ChainErrors() == 0);
+}
+
+int main(int argc, char *argv[])
+{
+  if((argc > 1) && (strcmp(argv[1], "--replay") == 0)) return TraceReplayFile(argc, argv);
+
+  uint32_t number_cases = (argc > 1) ? strtoul(argv[1], NULL, 0) : 100;
+  uint32_t first_seed = (argc > 2) ? strtoul(argv[2], NULL, 0) : 1;
+  uint32_t failed_cases = 0;
+
+  for(uint32_t seed = first_seed; seed < first_seed + number_cases; seed++)
+  {
+    pid_t case_process = fork();
+    if(case_process == 0)
+    {
+      bool passed = TraceCase(seed);
+      if(passed == false) printf("trace_test: seed %u FAILED\n", seed);
+      fflush(stdout);
+      _exit(passed ? 0 : 1);
+    }
+
+    int case_status = 0;
+    waitpid(case_process, &case_status, 0);
+    if((WIFEXITED(case_status) == 0) || (WEXITSTATUS(case_status) != 0)) failed_cases++;
+  }
+
+  printf("trace_test: %u cases, %u failed\n", number_cases, failed_cases);
+  return (failed_cases == 0) ? 0 : 1;
+}
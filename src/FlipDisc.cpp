@@ -10,6 +10,15 @@
 
 #include "FlipDisc.h"
 
+/*
+ * The boards with EEPROM or EEPROM emulated in flash, 
+ * required to save the wear counters of the discs
+ */
+#if defined(__AVR__) || defined(ARDUINO_ARCH_ESP32) || defined(ARDUINO_ARCH_ESP8266)
+#include <EEPROM.h>
+#define FLIPDISC_EEPROM
+#endif
+
 /* 
  * Declaration of the flip-disc display enable pin   
  * EN_PIN - the pin serves as a latch for shift registers on which 
@@ -23,17 +32,580 @@ uint16_t _EN_PIN = 0;       // Start & End SPI transfer data
 uint16_t _CH_PIN  = 0;      // Charging PSPS module - turn ON/OFF
 uint16_t _PL_PIN  = 0;      // Release the current pulse - turn ON/OFF
 
-uint8_t flip_delay = 0;     // Variable for the delay effect between flip discs
-uint32_t time_now = 0;      // Variable for the millis() function
+uint32_t flip_delay = 0;    // Variable for the delay effect between flip discs in microseconds
+
+/*
+ * Delay effect of the individual modules, one for each of the eight modules in the series.
+ * -> moduleDelayArray[] - delay effect of the module in microseconds
+ * -> module_delay_mask - bit "1" - the module has its own delay effect, "0" - flip_delay
+ * -> moduleGapArray[] - delay effect after the last flip of the module in microseconds
+ * -> moduleGapStartArray[] - micros() at the end of the last flip of the module
+ * The gaps of the modules run independently, so in the QUEUE mode the discs 
+ * of the other modules are flipped while a slow module waits.
+ */
+uint32_t moduleDelayArray[8];
+uint8_t module_delay_mask = 0;
+uint32_t moduleGapArray[8];
+uint32_t moduleGapStartArray[8];
+
+/*
+ * Flip-rate governor - token bucket protecting the Pulse Shaper Power Supply module.
+ * The bucket is kept as a credit of microseconds, each flip costs 1000000/flip_rate us
+ * and the credit can grow up to flip_burst flips. flip_rate = 0 - governor disabled.
+ */
+uint16_t flip_rate = 0;         // Sustained number of flips per second
+uint8_t flip_burst = 1;         // Number of flips that can be released back to back
+uint32_t flip_credit = 0;       // Current bucket credit in microseconds
+uint32_t flip_credit_time = 0;  // Last credit update, micros() 
+uint32_t throttle_count = 0;    // Number of flips delayed by the governor
+uint32_t throttle_time = 0;     // Total time of governor delays in microseconds
+bool flip_held = false;         // "1" - the next flip has already been held back by the governor
+uint32_t flip_held_time = 0;    // micros() when Service() held back the next flip
+uint32_t flip_held_wait = 0;    // Governor delay of the held flip at that time in microseconds
         
 /* 
- * 2-dimensional array with 3 columns.
+ * 2-dimensional array with 5 columns.
  * The first column lists all connected displays "module_type_column",
  * the second column is the number of data bytes required to control the display "number_bytes_column",
  * the third column is a number defining the relative position of the modules
- * in relation to each other and for each type separately "module_relative_position_column". 
+ * in relation to each other and for each type separately "module_relative_position_column",
+ * the fourth column is the number of discs of the display "number_discs_column",
+ * the fifth column is the priority of the display in the queue of pending flips "module_priority_column". 
+ */
+uint8_t moduleInitArray[8][5];
+
+/*
+ * The state of all discs of all displays and the queue of pending flips.
+ * One row for each of the eight modules in the series, the largest display (4x3x3) 
+ * has 36 discs, so each row consists of 5 bytes - one bit per disc.
+ * Disc numbers in individual bytes: 7,6,5,4,3,2,1,0  15,14,13,12,11,10,9,8 ...
+ * -> discStateArray[][] - the last status released into the disc
+ * -> discKnownArray[][] - "1" - the disc has been flipped since power up, its status is known
+ * -> discPendingArray[][] - "1" - the disc is waiting in the queue to be flipped
+ * -> discTargetArray[][] - the status to which a pending disc will be flipped
+ * The queue is keyed by module and disc, so a newer status replaces or cancels 
+ * the pending one and the number of pending flips never exceeds the number of discs.
+ */
+uint8_t discStateArray[8][5];
+uint8_t discKnownArray[8][5];
+uint8_t discPendingArray[8][5];
+uint8_t discTargetArray[8][5];
+
+/*
+ * Ring buffer of the frames submitted in the QUEUE mode when the frame rate is limited.
+ * -> frameTargetArray[][][] - the new disc statuses of the frame
+ * -> frameMaskArray[][][] - "1" - the frame contains a new status of the disc
+ * Complete frames wait in the buffer from frame_first, the next slot is the frame 
+ * being written. The oldest frame is moved to the queue of pending flips at most once 
+ * per frame_interval. Without the lookahead only one complete frame waits, a newer frame 
+ * overwrites it, so the display always converges to the newest frame.
+ * Both arrays are allocated by the first FrameRate() call with a frame rate limit,
+ * NULL - the frame buffer is not used.
+ */
+uint8_t (*frameTargetArray)[8][5] = NULL;
+uint8_t (*frameMaskArray)[8][5] = NULL;
+uint8_t frame_first = 0;        // Buffer slot of the oldest complete frame
+uint8_t frame_count = 0;        // Number of complete frames waiting in the buffer
+uint16_t frame_interval = 0;    // Minimum time between frames in ms, 0 - frame rate not limited
+uint32_t frame_time = 0;        // millis() of the last frame moved to the queue
+uint32_t frames_dropped = 0;    // Number of frames overwritten before they were displayed
+
+/*
+ * Lookahead planner - a flip which would be reverted by one of the waiting frames
+ * sooner than lookahead_hold ms after it is displayed is skipped, e.g. the discs 
+ * blinking for one frame of scrolling text.
+ */
+uint16_t lookahead_hold = 0;    // Minimum hold time of the flip in ms, 0 - planner disabled
+uint32_t pulses_saved = 0;      // Number of current pulses saved by the planner
+
+uint8_t update_mode = DIRECT;   // DIRECT - flip discs immediately, QUEUE - save flips in the queue
+bool queue_input = false;       // "1" - calls of the display functions are saved in the queue
+bool flip_forced = false;       // "1" - the discs are pulsed even if they already show the status
+
+/*
+ * Deadline of the queued frame - the moment, millis(), at which the last disc of the frame 
+ * should be flipped. The flipping starts early enough to land the last flip at the deadline.
+ */
+uint32_t frame_deadline = 0;    // millis() - the frame should be visible at
+bool frame_deadline_set = false;  // "1" - there is a deadline for the queued frame
+bool frame_started = false;     // "1" - the first disc of the frame has been flipped
+int32_t deadline_miss = 0;      // The last flip of the last frame minus its deadline in ms
+uint32_t last_flip_time = 0;    // millis() of the last released current pulse
+
+/*
+ * User callbacks of the flip engine, NULL - no callback
+ * -> flip_callback - after each released current pulse
+ * -> frame_callback - after the last disc of the frame has been flipped
+ * -> empty_callback - the queue of pending flips and the frame buffer are empty
+ */
+void (*flip_callback)(uint8_t module_type, uint8_t module_number, uint8_t disc_number, bool disc_status, uint32_t flip_time) = NULL;
+void (*frame_callback)(void) = NULL;
+void (*empty_callback)(void) = NULL;
+bool frame_flipping = false;    // "1" - the discs of the frame are waiting in the queue
+
+/*
+ * Integrity refresh sweep - in idle time the known discs are re-pulsed one by one 
+ * to their saved status, e.g. to restore the discs knocked out by vibration.
+ */
+uint16_t refresh_interval = 0;  // Time between the refresh pulses in ms, 0 - sweep disabled
+uint32_t refresh_time = 0;      // millis() of the last refresh pulse
+uint8_t refresh_position = 0;   // The next disc of the sweep - absolute position of the display
+uint8_t refresh_disc = 0;       // The next disc of the sweep - disc number
+
+#if FLIPDISC_STATS
+/*
+ * Performance counters - see FlipStats in FlipDisc.h.
+ * The payload bytes and the average update time are calculated in GetStats().
+ */
+FlipStats flip_stats;
+uint32_t spi_frame_bytes = 0;   // All bytes of the data frames of the released pulses
+uint32_t update_time_total = 0; // Sum of the update times in microseconds
+uint32_t update_start = 0;      // micros() at the start of the update in progress
+#endif
+bool update_started = false;    // "1" - an update is in progress
+
+#if defined(FLIPDISC_EEPROM)
+/*
+ * Wear counters - the number of flips of each disc of all displays.
+ * The flips are counted in RAM in wearDeltaArray[] (one byte per disc, allocated 
+ * by WearBegin()) and added in batches to the 32-bit counters saved in the EEPROM.
+ * Each batch is saved in the next of wear_slots slots, so the EEPROM wear is spread
+ * over all slots, and the slot is valid only after its sequence number is written.
+ * Slot: sequence number (2 bytes), number of discs (2 bytes), counters (4 bytes per disc),
+ * checksum (1 byte).
+ */
+uint8_t *wearDeltaArray = NULL;  // Flips not yet saved in the EEPROM, NULL - counters disabled
+uint16_t wear_address = 0;      // EEPROM address of the first slot
+uint16_t wear_discs = 0;        // Number of discs of all displays
+uint8_t wear_slots = 0;         // Number of slots
+uint8_t wear_slot = 0;          // The slot with the newest counters
+uint16_t wear_sequence = 0;     // Sequence number of the newest slot
+bool wear_valid = false;        // "1" - a valid slot has been found or saved
+bool wear_save_needed = false;  // "1" - one of the RAM counters is almost full
+uint16_t wear_save_offset = 0;  // The next byte of the slot being saved, 0 - no save in progress
+uint8_t wear_save_checksum = 0; // Checksum of the bytes of the save in progress
+uint32_t wear_save_counter = 0; // The counter of the disc being saved
+
+/*
+ * Saved state of the discs - discStateArray[][] and discKnownArray[][] saved in the EEPROM,
+ * restored after power up so the first update flips only the discs that differ.
+ * Record: marker (1 byte), types of the eight modules (8 bytes), discStateArray[][] (40 bytes),
+ * discKnownArray[][] (40 bytes), CRC-8 of the types and arrays (1 byte).
+ * The record is restored only with the state_valid marker and the correct CRC. The marker 
+ * is cleared before the first pulse which changes a disc after the save, so the record 
+ * saved before the change is never restored, and it is set again after the next save.
+ */
+static const uint8_t state_valid = 0xA5;
+static const uint8_t state_record_size = 1 + 8 + 40 + 40 + 1;
+
+uint16_t state_address = 0;     // EEPROM address of the saved state
+uint16_t state_interval = 0;    // Minimum time between the saves in seconds
+uint32_t state_save_time = 0;   // millis() of the last save
+bool state_enabled = false;     // "1" - the state is saved in the EEPROM
+bool state_dirty = false;       // "1" - a disc has been flipped since the last save
+bool state_saved = false;       // "1" - the marker of the record in the EEPROM is valid
+uint8_t state_save_byte = 0xFF; // The next step of the save in progress, 0xFF - no save in progress
+uint8_t state_save_crc = 0;     // CRC of the bytes of the save in progress
+
+/*
+ * Estimated time of the EEPROM writes in microseconds, used by Service() to save 
+ * the wear counters and the state byte by byte within its time limit.
+ * AVR - about 3.3ms per byte. ESP32/ESP8266 - the byte is written to RAM, 
+ * but the commit erases and writes a flash sector.
+ */
+#if defined(ARDUINO_ARCH_ESP32) || defined(ARDUINO_ARCH_ESP8266)
+static const uint32_t eeprom_write_time = 10;
+static const uint32_t eeprom_commit_time = 50000;
+#else
+static const uint32_t eeprom_write_time = 3400;
+static const uint32_t eeprom_commit_time = 0;
+#endif
+uint16_t eeprom_size = 0;       // EEPROM size requested from the ESP32/ESP8266 flash emulation
+#endif
+
+/*
+ * Trace recorder - every edge of the EN, CH and PL pins and every SPI byte, saved with 
+ * its time in a ring buffer of trace_size records allocated by TraceBegin(). 
+ * Record: time since the previous record in microseconds (65535 - 65535 or more),
+ * signal - trace_en, trace_ch, trace_pl or trace_spi, data - pin level or SPI byte.
+ * When the buffer is full, the newest record overwrites the oldest one.
+ */
+static const uint8_t trace_en  = 0;
+static const uint8_t trace_ch  = 1;
+static const uint8_t trace_pl  = 2;
+static const uint8_t trace_spi = 3;
+
+typedef struct
+{
+  uint16_t time_delta;
+  uint8_t signal;
+  uint8_t data;
+} TraceRecord;
+
+TraceRecord *traceArray = NULL; // Ring buffer of the records, NULL - trace disabled
+uint16_t trace_size = 0;        // Number of records of the ring buffer
+uint16_t trace_next = 0;        // The slot of the next record
+uint16_t trace_count = 0;       // Number of saved records
+uint32_t trace_lost = 0;        // Number of the oldest records overwritten by the newer ones
+uint32_t trace_time = 0;        // micros() of the previous record
+
+/*
+ * Completion callbacks of the task handles, one for each of the eight modules in the series.
+ * The callback is called once, when the last pending disc of the module has been flipped.
+ */
+void (*taskCallbackArray[8])(void);
+
+/*
+ * Text output - print() and println() show the characters on the displays of one type,
+ * see Text(). The cursor is the relative number of the display for the next character.
+ * UTF-8 sequences are collected in text_code_point until text_utf8_bytes is 0.
+ */
+uint8_t text_type = D7SEG;      // Type of the displays showing the text, D7SEG or D3X5
+uint8_t text_first = 1;         // Relative number of the display showing the first character
+uint8_t text_cursor = 1;        // Relative number of the display for the next character
+uint32_t text_code_point = 0;   // Code point of the UTF-8 sequence being received
+uint8_t text_utf8_bytes = 0;    // Number of the UTF-8 continuation bytes still expected
+
+/*
+ * Numbers shown by Number() and their deadband, see Hysteresis().
+ * The candidate is the last number within the deadband and the time it was first seen.
+ */
+uint32_t number_threshold = 0;      // The smallest change shown at once, 0 - every change
+uint16_t number_stable_time = 0;    // Time in ms after which a smaller change is shown, 0 - never
+int32_t number_shown = 0;           // The number on the displays
+bool number_shown_valid = false;    // "0" - the next number is always shown
+uint8_t number_decimals = 0;        // Decimals of the number on the displays
+uint8_t number_unit = NONE;         // Unit of the number on the displays
+int32_t number_candidate = 0;       // The last number within the deadband
+uint32_t number_candidate_time = 0; // millis() when the candidate was first seen
+
+#if defined(ARDUINO_ARCH_ESP32)
+/*
+ * ESP32 driver task - the only task which flips the discs after Driver() is called.
+ * Other tasks pass the disc commands to the driver task through a lock-free queue 
+ * (bounded multi-producer single-consumer ring), so no mutex is held across the pulses.
+ * Each slot has a sequence number - the slot is free for the producer when 
+ * the sequence equals the producer index and ready for the driver task when 
+ * it equals the index + 1. A command with disc_number = 0xFF marks the end of a frame.
+ */
+static const uint8_t driver_queue_size = 64;   // Must be a power of 2
+
+typedef struct
+{
+  uint32_t sequence;
+  uint8_t module_position;
+  uint8_t disc_number;
+  bool disc_status;
+} DriverCommand;
+
+DriverCommand driverQueueArray[driver_queue_size];
+uint32_t driver_tail = 0;       // Next slot for the producers, incremented atomically
+uint32_t driver_head = 0;       // Next slot for the driver task
+uint8_t driverCountArray[8];    // Number of commands of the module waiting in the driver queue
+TaskHandle_t driver_task = NULL;
+
+/*
+ * The pending discs and the completion callbacks are shared by the driver task 
+ * and the application tasks (FlipTask). The spinlock makes each change of them 
+ * by the driver task and each check by an application task atomic. 
+ * It is held only for a few bit operations, never across a pulse.
+ */
+portMUX_TYPE driver_lock = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
+/*
+ * Time source of the library - the current time in microseconds and milliseconds 
+ * and a blocking wait in microseconds. By default micros(), millis(), delay() and 
+ * delayMicroseconds(). The virtual clock advances only when the library waits, 
+ * instantly, so a simulation of thousands of updates keeps an accurate timeline 
+ * of the flips but takes no real time.
+ */
+static uint32_t RealMicros(void)
+{
+  return micros();
+}
+
+static uint32_t RealMillis(void)
+{
+  return millis();
+}
+
+static void RealWait(uint32_t wait_time)
+{
+  if(wait_time >= 1000) delay(wait_time / 1000);
+  if(wait_time % 1000 > 0) delayMicroseconds(wait_time % 1000);
+}
+
+uint32_t virtual_micros = 0;      // Time of the virtual clock in microseconds
+uint32_t virtual_millis = 0;      // Time of the virtual clock in milliseconds
+uint16_t virtual_micros_rest = 0; // Microseconds since the last whole millisecond
+
+static uint32_t VirtualMicros(void)
+{
+  return virtual_micros;
+}
+
+static uint32_t VirtualMillis(void)
+{
+  return virtual_millis;
+}
+
+static void VirtualWait(uint32_t wait_time)
+{
+  virtual_micros = virtual_micros + wait_time;
+  
+  uint32_t micros_rest = virtual_micros_rest + wait_time;
+  virtual_millis = virtual_millis + micros_rest / 1000;
+  virtual_micros_rest = micros_rest % 1000;
+}
+
+uint32_t (*clock_micros)(void) = RealMicros;
+uint32_t (*clock_millis)(void) = RealMillis;
+void (*clock_wait)(uint32_t wait_time) = RealWait;
+
+/*
+ * Wait in the polling loops - with the real clock the loop itself waits, 
+ * any other clock is moved forward by the remaining time
+ */
+static void ClockIdle(uint32_t wait_time)
+{
+  if(clock_wait != RealWait) clock_wait(wait_time);
+}
+
+/*
+ * Save one record of the trace recorder
+ */
+static void TraceSave(uint8_t trace_signal, uint8_t trace_data)
+{
+  uint32_t current_time = clock_micros();
+  uint32_t time_delta = current_time - trace_time;
+  trace_time = current_time;
+
+  if(time_delta > 0xFFFF) time_delta = 0xFFFF;
+  
+  traceArray[trace_next].time_delta = time_delta;
+  traceArray[trace_next].signal = trace_signal;
+  traceArray[trace_next].data = trace_data;
+
+  trace_next = (trace_next + 1) % trace_size;
+  
+  if(trace_count < trace_size) trace_count = trace_count + 1;
+  else trace_lost = trace_lost + 1;
+}
+
+/*
+ * Send one byte to the displays through SPI
+ */
+static void SpiTransfer(uint8_t spi_data)
+{
+  SPI.transfer(spi_data);
+  if(traceArray != NULL) TraceSave(trace_spi, spi_data);
+}
+
+/*
+ * Read and write one bit of the selected disc in one of the disc arrays
+ */
+static bool ReadDiscBit(uint8_t discArray[][5], uint8_t module_position, uint8_t disc_number)
+{
+  return (discArray[module_position][disc_number >> 3] >> (disc_number & 0x07)) & 0b00000001;
+}
+
+static void WriteDiscBit(uint8_t discArray[][5], uint8_t module_position, uint8_t disc_number, bool disc_bit)
+{
+  if(disc_bit == 1) discArray[module_position][disc_number >> 3] |= (1 << (disc_number & 0x07));
+  else discArray[module_position][disc_number >> 3] &= ~(1 << (disc_number & 0x07));
+}
+
+#if defined(FLIPDISC_EEPROM)
+/*
+ * Read and write the EEPROM - little-endian numbers, a byte is written only if it changes
+ */
+static uint32_t EepromRead(uint16_t eeprom_address, uint8_t number_bytes)
+{
+  uint32_t eeprom_data = 0;
+  
+  for(int i = number_bytes - 1; i >= 0; i--) eeprom_data = (eeprom_data << 8) | EEPROM.read(eeprom_address + i);
+  return eeprom_data;
+}
+
+static void EepromWrite(uint16_t eeprom_address, uint32_t eeprom_data, uint8_t number_bytes, uint8_t &checksum)
+{
+  for(int i = 0; i < number_bytes; i++)
+  {
+    uint8_t data_byte = (eeprom_data >> (8 * i)) & 0xFF;
+    
+    if(EEPROM.read(eeprom_address + i) != data_byte) EEPROM.write(eeprom_address + i, data_byte);
+    checksum = checksum + data_byte;
+  }
+}
+
+/*
+ * ESP32/ESP8266 - the EEPROM emulated in flash must cover the wear counters and the saved state
+ */
+static void EepromBegin(uint16_t eeprom_end)
+{
+#if defined(ARDUINO_ARCH_ESP32) || defined(ARDUINO_ARCH_ESP8266)
+  if(eeprom_end <= eeprom_size) return;
+  
+  eeprom_size = eeprom_end;
+  EEPROM.begin(eeprom_size);
+#else
+  (void)eeprom_end;
+#endif
+}
+
+static void EepromCommit(void)
+{
+#if defined(ARDUINO_ARCH_ESP32) || defined(ARDUINO_ARCH_ESP8266)
+  EEPROM.commit();
+#endif
+}
+
+/*
+ * CRC-8 (Dallas/Maxim, polynomial 0x31 reflected) of the saved state, one byte at a time
+ */
+static uint8_t StateCrc(uint8_t crc, uint8_t data_byte)
+{
+  for(int i = 0; i < 8; i++)
+  {
+    bool crc_mix = (crc ^ data_byte) & 0b00000001;
+    crc = crc >> 1;
+    if(crc_mix == 1) crc = crc ^ 0x8C;
+    data_byte = data_byte >> 1;
+  }
+
+  return crc;
+}
+
+/*
+ * The state of the discs has changed - a save is needed, the save in progress starts again
+ */
+static void StateChanged(void)
+{
+  state_dirty = true;
+  if(state_save_byte != 0xFF) state_save_byte = 0;
+}
+
+/*
+ * The byte of the state record: 0-7 module types, 8-47 discStateArray[][], 48-87 discKnownArray[][]
+ */
+static uint8_t StateByte(uint8_t byte_number)
+{
+  if(byte_number < 8) return moduleInitArray[byte_number][module_type_column];
+  if(byte_number < 48) return discStateArray[(byte_number - 8) / 5][(byte_number - 8) % 5];
+  return discKnownArray[(byte_number - 48) / 5][(byte_number - 48) % 5];
+}
+
+/*
+ * The wear counters slot - size in bytes and EEPROM address
+ */
+static uint16_t WearSlotSize(void)
+{
+  return 2 + 2 + 4 * wear_discs + 1;
+}
+
+static uint16_t WearSlotAddress(uint8_t slot_number)
+{
+  return wear_address + slot_number * WearSlotSize();
+}
+
+/*
+ * The slot is valid if it was saved for the same number of discs and its checksum is correct
+ */
+static bool WearSlotValid(uint8_t slot_number)
+{
+  uint16_t slot_address = WearSlotAddress(slot_number);
+  uint8_t checksum = 0;
+
+  if(EepromRead(slot_address + 2, 2) != wear_discs) return 0;
+  
+  for(int i = 2; i < WearSlotSize() - 1; i++) checksum = checksum + EEPROM.read(slot_address + i);
+  
+  return (checksum == EEPROM.read(slot_address + WearSlotSize() - 1));
+}
+
+/*
+ * The index of the disc in the wear counters - the discs of all displays one after another
+ */
+static uint16_t DiscIndex(uint8_t module_position, uint8_t disc_number)
+{
+  uint16_t disc_index = disc_number;
+  
+  for(int i = 0; i < module_position; i++) disc_index = disc_index + moduleInitArray[i][number_discs_column];
+  return disc_index;
+}
+#endif
+
+/*
+ * The marker of the saved state is cleared before the first flip after the save - 
+ * the time of the write and of the commit, 0 - the marker is already cleared
+ */
+static uint32_t StateClearTime(void)
+{
+#if defined(FLIPDISC_EEPROM)
+  if((state_enabled == false) || (state_saved == false)) return 0;
+  return eeprom_write_time + eeprom_commit_time;
+#else
+  return 0;
+#endif
+}
+
+static void StateClear(void)
+{
+#if defined(FLIPDISC_EEPROM)
+  uint8_t no_checksum = 0;
+  EepromWrite(state_address, 0, 1, no_checksum);
+  EepromCommit();
+  
+  state_saved = false;
+#endif
+}
+
+/*
+ * ESP32 - critical section of the pending discs and of the completion callbacks,
+ * see driver_lock. No effect on the other boards.
+ */
+static void DriverLock(void)
+{
+#if defined(ARDUINO_ARCH_ESP32)
+  portENTER_CRITICAL(&driver_lock);
+#endif
+}
+
+static void DriverUnlock(void)
+{
+#if defined(ARDUINO_ARCH_ESP32)
+  portEXIT_CRITICAL(&driver_lock);
+#endif
+}
+
+/*
+ * The number of discs of the selected module waiting in the queue of pending flips
+ * or in the frame buffer. Call it between DriverLock() and DriverUnlock().
  */
-uint8_t moduleInitArray[8][3];
+static uint8_t ModulePending(uint8_t module_position)
+{
+  uint8_t pending_discs = 0;
+
+  for(int disc_number = 0; disc_number < moduleInitArray[module_position][number_discs_column]; disc_number++)
+  {
+    bool disc_pending = ReadDiscBit(discPendingArray, module_position, disc_number);
+    
+    for(int frame_slot = 0; (frameMaskArray != NULL) && (frame_slot < frame_buffer_size); frame_slot++)
+    {
+      disc_pending = disc_pending | ReadDiscBit(frameMaskArray[frame_slot], module_position, disc_number);
+    }
+
+    pending_discs = pending_discs + disc_pending;
+  }
+
+#if defined(ARDUINO_ARCH_ESP32)
+  // The commands not yet taken from the driver queue
+  pending_discs = pending_discs + __atomic_load_n(&driverCountArray[module_position], __ATOMIC_ACQUIRE);
+#endif
+
+  return pending_discs;
+}
 
 /* 
  *  An array of defined display names:
@@ -145,6 +717,7 @@ void FlipDisc::Init(uint8_t MOD1, uint8_t MOD2 /* = 0xFF */, uint8_t MOD3 /*= 0x
  * set to "1" the rest of the data is "0".
  */
   uint8_t number_bytes = 0;
+  uint8_t number_discs = 0;
   
   for(int i = 0; i < 8; i++)
   {
@@ -152,56 +725,71 @@ void FlipDisc::Init(uint8_t MOD1, uint8_t MOD2 /* = 0xFF */, uint8_t MOD3 /*= 0x
     {
       case D7SEG:
         number_bytes = 3;
+        number_discs = 23;
         break;
 
       case D2X1:
         number_bytes = 1;
+        number_discs = 2;
         break; 
 
       case D3X1:
         number_bytes = 1;
+        number_discs = 3;
         break; 
 
       case D1X3:
         number_bytes = 1;
+        number_discs = 3;
         break;
         
       case D1X7:
         number_bytes = 2;
+        number_discs = 7;
         break;
 		
       case D2X6:
         number_bytes = 2;
+        number_discs = 12;
         break; 			
 
       case D3X3:
         number_bytes = 2;
+        number_discs = 9;
         break;   		
 
       case D3X4:
         number_bytes = 2;
+        number_discs = 12;
         break;  
 
       case D3X5:
         number_bytes = 2;
+        number_discs = 15;
         break;
 
       case D4X3X3:
         number_bytes = 3;
+        number_discs = 36;
         break;		
       
       case NONE:
         number_bytes = 3;
+        number_discs = 0;
         break;   
         
       default:
         number_bytes = 3;
+        number_discs = 0;
         break;
     }
     
     // Saving data about the number of data bytes required by the module
     moduleInitArray[i][number_bytes_column] = number_bytes;
 
+    // Saving the number of discs of the module
+    moduleInitArray[i][number_discs_column] = number_discs;
+
     // Total length of data frame for all displays.
     number_all_bytes = number_all_bytes + number_bytes; 
   }
@@ -246,14 +834,18 @@ void FlipDisc::Matrix_7Seg(uint8_t data1, uint8_t data2 /* = 0xFF */, uint8_t da
  * displayed are contained in two tables:                                           *
  * -> setDiscArray_7Seg[][] - "1"                                                   *
  * -> resetDiscArray_7Seg[][] - "0"                                                 *
+ * Returns the handle of the update - see FlipTask                                  *
  *----------------------------------------------------------------------------------*/
-void FlipDisc::Display_7Seg(uint8_t module_number, uint8_t new_data)
+FlipTask FlipDisc::Display_7Seg(uint8_t module_number, uint8_t new_data)
 {
  /*
   * Simple protection from user error. 
   * If the selected display has not been declared in Init() then the function will not execute.
   */
-  if(Fuse(module_number, D7SEG) == true) return;
+  if(Fuse(module_number, D7SEG) == true) return FlipTask();
+
+  // Symbols 0-45 only
+  if(new_data > 45) return FlipTask();
   
   bool disc_status = 0;
   uint8_t bit_number = 0;
@@ -283,6 +875,9 @@ void FlipDisc::Display_7Seg(uint8_t module_number, uint8_t new_data)
   }
   // Finally, clear all display outputs
   ClearAllOutputs();
+
+  // The handle of the update, done at once in the DIRECT mode
+  return FlipTask(ModulePosition(module_number, D7SEG));
 }
 
 
@@ -317,8 +912,21 @@ void FlipDisc::Display_7Seg(uint8_t module_number, uint8_t new_data)
  *----------------------------------------------------------------------------------*/
 void FlipDisc::Disc_7Seg(uint8_t module_number, uint8_t disc_number, bool disc_status)
 {
+   /*
+    * Simple protection from user error. 
+    * If the selected display has not been declared in Init() or the display 
+    * has no such disc then the function will not execute.
+    */
+    if(DiscFuse(module_number, D7SEG, disc_number) == true) return;
+    
+   /*
+    * In the QUEUE mode the disc is not flipped immediately,
+    * the new disc status is saved in the queue of pending flips.
+    */
+    if(Queue(D7SEG, module_number, disc_number, disc_status) == true) return;
+
     // Start of SPI data transfer
-    digitalWrite(_EN_PIN, LOW);
+    PinWrite(_EN_PIN, LOW);
 
    /* 
     * Send blank data "0" to all control outputs of the other displays BEFORE 
@@ -345,8 +953,8 @@ void FlipDisc::Disc_7Seg(uint8_t module_number, uint8_t disc_number, bool disc_s
     
     for(int byte_number = 0; byte_number < 3; byte_number++)
     {
-      if(disc_status == 0) SPI.transfer(pgm_read_byte(&setDiscArray_7Seg[disc_number][byte_number]));
-      if(disc_status == 1) SPI.transfer(pgm_read_byte(&resetDiscArray_7Seg[disc_number][byte_number]));
+      if(disc_status == 0) SpiTransfer(pgm_read_byte(&setDiscArray_7Seg[disc_number][byte_number]));
+      if(disc_status == 1) SpiTransfer(pgm_read_byte(&resetDiscArray_7Seg[disc_number][byte_number]));
     }
 
    /* 
@@ -357,10 +965,10 @@ void FlipDisc::Disc_7Seg(uint8_t module_number, uint8_t disc_number, bool disc_s
     SendBlankData(module_number, D7SEG, AFTER);
 
     // End of SPI data transfer
-    digitalWrite(_EN_PIN, HIGH);
+    PinWrite(_EN_PIN, HIGH);
     
     // Release of 1ms current pulse
-    ReleaseCurrentPulse();  
+    ReleaseCurrentPulse(D7SEG, module_number, disc_number, disc_status);  
 }
 
 /*----------------------------------------------------------------------------------*
@@ -407,7 +1015,18 @@ void FlipDisc::Disc_3x1(uint8_t module_number, uint8_t disc_number, bool disc_st
  *----------------------------------------------------------------------------------*/
 void FlipDisc::Disc_2x1(uint8_t module_number, uint8_t disc_number, bool disc_status)
 {
-  Disc_3x1(module_number, disc_number, disc_status);    
+  if(Fuse(module_number, D2X1) == true) return;
+  
+  uint8_t newDiscArray[2];
+  
+  for(int i = 1; i <= 2; i++)
+  {
+    if(disc_number == i) newDiscArray[i-1] = disc_status;
+    else newDiscArray[i-1] = 0xFF; 
+  }
+  
+  Display_2x1(module_number, newDiscArray[0], newDiscArray[1]);
+  ClearAllOutputs();
 }
 
 /*----------------------------------------------------------------------------------*
@@ -429,35 +1048,49 @@ void FlipDisc::Disc_2x1(uint8_t module_number, uint8_t disc_number, bool disc_st
  * -> resetDiscArray_3x1[] - "0"                                                    *
  *----------------------------------------------------------------------------------*/
 void FlipDisc::Display_3x1(uint8_t module_number, uint8_t disc1 /* = 0xFF */, uint8_t disc2 /* = 0xFF */, uint8_t disc3 /* = 0xFF */)
+{
+  DisplayDots(D3X1, module_number, disc1, disc2, disc3);
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function flips the discs of the 2x1 or 3x1 display - see Display_3x1()       *
+ * -> module_type - D2X1 or D3X1                                                    *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::DisplayDots(uint8_t module_type, uint8_t module_number, uint8_t disc1, uint8_t disc2, uint8_t disc3)
 {
  /*
   * Simple protection from user error. 
   * If the selected display has not been declared in Init() then the function will not execute.
   */
-  if(Fuse(module_number, D3X1) == true) return;
+  if(Fuse(module_number, module_type) == true) return;
   
   // Saving a list of dot statuses to the array
   uint8_t newDiscArray[3] = {disc1, disc2, disc3};
 
-  // 3 D3X1 - 3 loops
+  // 3 discs - 3 loops
   for(int disc = 0; disc < 3; disc++)
   {  
     // Check if we have new data for dot. 0xFF - no data
     if(newDiscArray[disc] != 0xFF)
     {
+      // In the QUEUE mode the new disc status is only saved in the queue of pending flips
+      if(Queue(module_type, module_number, disc, newDiscArray[disc]) == true) continue;
+
       // Start of SPI data transfer
-      digitalWrite(_EN_PIN, LOW);
+      PinWrite(_EN_PIN, LOW);
 
      /* 
       * Send blank data "0" to all control outputs of the other displays BEFORE 
       * sending control data to the selected display.
       * Detailed information in the function description SendBlankData().
       */
-      SendBlankData(module_number, D3X1, BEFORE);
+      SendBlankData(module_number, module_type, BEFORE);
 
      /*
       * Each of the discs has two sides, one side corresponds to the disk status "1" - color, 
-      * the other side "0" - black. 
+      * the other side "0" - black. Any status other than "0" sets the disc, so exactly 
+      * one control byte of the display is sent. 
       * Each of the "0" or "1" statuses requires a different polarity of the current pulse 
       * released into the disc, and thus for each of the statuses we must drive different 
       * controller outputs to achieve the desired effect. 
@@ -468,21 +1101,21 @@ void FlipDisc::Display_3x1(uint8_t module_number, uint8_t disc1 /* = 0xFF */, ui
       * Each separate display disc requires 1 byte of data to be transferred. 
       * To flip all 3 discs, we need to send 3 bytes of data.
       */
-      if(newDiscArray[disc] == 1) SPI.transfer(pgm_read_byte(&setDiscArray_3x1[disc]));
-      if(newDiscArray[disc] == 0) SPI.transfer(pgm_read_byte(&resetDiscArray_3x1[disc]));
+      if(newDiscArray[disc] != 0) SpiTransfer(pgm_read_byte(&setDiscArray_3x1[disc]));
+      if(newDiscArray[disc] == 0) SpiTransfer(pgm_read_byte(&resetDiscArray_3x1[disc]));
       
      /* 
       * Send blank data "0" to all control outputs of the other displays AFTER 
       * sending control data to the selected display.
       * Detailed information in the function description SendBlankData().
       */
-      SendBlankData(module_number, D3X1, AFTER);
+      SendBlankData(module_number, module_type, AFTER);
 
       // End of SPI data transfer
-      digitalWrite(_EN_PIN, HIGH);
+      PinWrite(_EN_PIN, HIGH);
 
       // Release of 1ms current pulse 
-      ReleaseCurrentPulse();
+      ReleaseCurrentPulse(module_type, module_number, disc, newDiscArray[disc]);
     }  
   }
 
@@ -495,7 +1128,7 @@ void FlipDisc::Display_3x1(uint8_t module_number, uint8_t disc1 /* = 0xFF */, ui
  *----------------------------------------------------------------------------------*/
 void FlipDisc::Display_2x1(uint8_t module_number, uint8_t disc1 /* = 0xFF */, uint8_t disc2 /* = 0xFF */)
 {
-  Display_3x1(module_number, disc1, disc2);
+  DisplayDots(D2X1, module_number, disc1, disc2, 0xFF);
 }
 
 /*----------------------------------------------------------------------------------*
@@ -572,8 +1205,11 @@ void FlipDisc::Display_1x3(uint8_t module_number, uint8_t disc1 /* = 0xFF */, ui
     // Check if we have new data for disc. 0xFF - no data
     if(newDiscArray[disc] != 0xFF)
     {
+      // In the QUEUE mode the new disc status is only saved in the queue of pending flips
+      if(Queue(D1X3, module_number, disc, newDiscArray[disc]) == true) continue;
+
       // Start of SPI data transfer
-      digitalWrite(_EN_PIN, LOW);
+      PinWrite(_EN_PIN, LOW);
 
      /* 
       * Send blank data "0" to all control outputs of the other displays BEFORE 
@@ -584,7 +1220,8 @@ void FlipDisc::Display_1x3(uint8_t module_number, uint8_t disc1 /* = 0xFF */, ui
 
      /*
       * Each of the discs has two sides, one side corresponds to the disk status "1" - color, 
-      * the other side "0" - black. 
+      * the other side "0" - black. Any status other than "0" sets the disc, so exactly 
+      * one control byte of the display is sent. 
       * Each of the "0" or "1" statuses requires a different polarity of the current pulse 
       * released into the disc, and thus for each of the statuses we must drive different 
       * controller outputs to achieve the desired effect. 
@@ -595,8 +1232,8 @@ void FlipDisc::Display_1x3(uint8_t module_number, uint8_t disc1 /* = 0xFF */, ui
       * Each separate display disc requires 1 byte of data to be transferred. 
       * To flip all 3 discs, we need to send 3 bytes of data.
       */
-      if(newDiscArray[disc] == 1) SPI.transfer(pgm_read_byte(&setDiscArray_1x3[disc]));
-      if(newDiscArray[disc] == 0) SPI.transfer(pgm_read_byte(&resetDiscArray_1x3[disc]));
+      if(newDiscArray[disc] != 0) SpiTransfer(pgm_read_byte(&setDiscArray_1x3[disc]));
+      if(newDiscArray[disc] == 0) SpiTransfer(pgm_read_byte(&resetDiscArray_1x3[disc]));
       
      /* 
       * Send blank data "0" to all control outputs of the other displays AFTER 
@@ -606,10 +1243,10 @@ void FlipDisc::Display_1x3(uint8_t module_number, uint8_t disc1 /* = 0xFF */, ui
       SendBlankData(module_number, D1X3, AFTER);
 
       // End of SPI data transfer
-      digitalWrite(_EN_PIN, HIGH);
+      PinWrite(_EN_PIN, HIGH);
 
       // Release of 1ms current pulse 
-      ReleaseCurrentPulse();
+      ReleaseCurrentPulse(D1X3, module_number, disc, newDiscArray[disc]);
     }  
   }
 
@@ -693,8 +1330,11 @@ void FlipDisc::Display_1x7(uint8_t module_number, uint8_t disc1 /* = 0xFF */, ui
     // Check if we have new data for disc. 0xFF - no data
     if(newDiscArray[disc] != 0xFF)
     {
+      // In the QUEUE mode the new disc status is only saved in the queue of pending flips
+      if(Queue(D1X7, module_number, disc, newDiscArray[disc]) == true) continue;
+
       // Start of SPI data transfer
-      digitalWrite(_EN_PIN, LOW);
+      PinWrite(_EN_PIN, LOW);
 
      /* 
       * Send blank data "0" to all control outputs of the other displays BEFORE 
@@ -705,7 +1345,8 @@ void FlipDisc::Display_1x7(uint8_t module_number, uint8_t disc1 /* = 0xFF */, ui
 
      /*
       * Each of the discs has two sides, one side corresponds to the disk status "1" - color, 
-      * the other side "0" - black. 
+      * the other side "0" - black. Any status other than "0" sets the disc, so exactly 
+      * one control byte of the display is sent. 
       * Each of the "0" or "1" statuses requires a different polarity of the current pulse 
       * released into the disc, and thus for each of the statuses we must drive different 
       * controller outputs to achieve the desired effect. 
@@ -718,8 +1359,8 @@ void FlipDisc::Display_1x7(uint8_t module_number, uint8_t disc1 /* = 0xFF */, ui
       */
       for(int byte_number = 0; byte_number < 2; byte_number++)
       {
-        if(newDiscArray[disc] == 1) SPI.transfer(pgm_read_byte(&setDiscArray_1x7[disc][byte_number]));
-        if(newDiscArray[disc] == 0) SPI.transfer(pgm_read_byte(&resetDiscArray_1x7[disc][byte_number]));
+        if(newDiscArray[disc] != 0) SpiTransfer(pgm_read_byte(&setDiscArray_1x7[disc][byte_number]));
+        if(newDiscArray[disc] == 0) SpiTransfer(pgm_read_byte(&resetDiscArray_1x7[disc][byte_number]));
       }
      /* 
       * Send blank data "0" to all control outputs of the other displays AFTER 
@@ -729,10 +1370,10 @@ void FlipDisc::Display_1x7(uint8_t module_number, uint8_t disc1 /* = 0xFF */, ui
       SendBlankData(module_number, D1X7, AFTER);
 
       // End of SPI data transfer
-      digitalWrite(_EN_PIN, HIGH);
+      PinWrite(_EN_PIN, HIGH);
 
       // Release of 1ms current pulse 
-      ReleaseCurrentPulse();
+      ReleaseCurrentPulse(D1X7, module_number, disc, newDiscArray[disc]);
     }  
   }
 
@@ -758,14 +1399,18 @@ void FlipDisc::Disc_2x6(uint8_t module_number, uint8_t disc_number, bool disc_st
 {
  /*
   * Simple protection from user error. 
-  * If the selected display has not been declared in Init() then the function will not execute.
+  * If the selected display has not been declared in Init() or the display 
+  * has no such disc then the function will not execute.
   */
-  if(Fuse(module_number, D2X6) == true) return;
+  if(DiscFuse(module_number, D2X6, disc_number) == true) return;
 
   disc_number = disc_number - 1;
+
+  // In the QUEUE mode the new disc status is only saved in the queue of pending flips
+  if(Queue(D2X6, module_number, disc_number, disc_status) == true) return;
 	
   // Start of SPI data transfer
-  digitalWrite(_EN_PIN, LOW);
+  PinWrite(_EN_PIN, LOW);
 
  /* 
   * Send blank data "0" to all control outputs of the other displays BEFORE 
@@ -789,8 +1434,8 @@ void FlipDisc::Disc_2x6(uint8_t module_number, uint8_t disc_number, bool disc_st
   */
   for(int byte_number = 0; byte_number < 2; byte_number++)
   {
-	if(disc_status == 1) SPI.transfer(pgm_read_byte(&setDiscArray_2x6[disc_number][byte_number]));
-	if(disc_status == 0) SPI.transfer(pgm_read_byte(&resetDiscArray_2x6[disc_number][byte_number]));
+	if(disc_status == 1) SpiTransfer(pgm_read_byte(&setDiscArray_2x6[disc_number][byte_number]));
+	if(disc_status == 0) SpiTransfer(pgm_read_byte(&resetDiscArray_2x6[disc_number][byte_number]));
   }
    
  /* 
@@ -801,10 +1446,10 @@ void FlipDisc::Disc_2x6(uint8_t module_number, uint8_t disc_number, bool disc_st
   SendBlankData(module_number, D2X6, AFTER);
 
   // End of SPI data transfer
-  digitalWrite(_EN_PIN, HIGH);
+  PinWrite(_EN_PIN, HIGH);
 
   // Release of 1ms current pulse 
-  ReleaseCurrentPulse();
+  ReleaseCurrentPulse(D2X6, module_number, disc_number, disc_status);
 
   // Clear all outputs of the controllers built into the displays
   ClearAllOutputs();
@@ -830,6 +1475,9 @@ void FlipDisc::Disc_2x6(uint8_t module_number, uint8_t disc_number, bool disc_st
  *----------------------------------------------------------------------------------*/
 void FlipDisc::Display_2x6(uint8_t module_number, uint8_t row_number, uint8_t column_number, bool disc_status)
 {
+  // Rows 1-2 and columns 1-6 only
+  if((row_number < 1) || (row_number > 2) || (column_number < 1) || (column_number > 6)) return;
+  
   // Based on the row (1-2) and column (1-6) disc address, we determine the disc number 1-12
   uint8_t disc_number = (row_number - 1) * 6 + column_number;	
   
@@ -855,14 +1503,18 @@ void FlipDisc::Disc_3x3(uint8_t module_number, uint8_t disc_number, bool disc_st
 {
  /*
   * Simple protection from user error. 
-  * If the selected display has not been declared in Init() then the function will not execute.
+  * If the selected display has not been declared in Init() or the display 
+  * has no such disc then the function will not execute.
   */
-  if(Fuse(module_number, D3X3) == true) return;
+  if(DiscFuse(module_number, D3X3, disc_number) == true) return;
 
   disc_number = disc_number - 1;
+
+  // In the QUEUE mode the new disc status is only saved in the queue of pending flips
+  if(Queue(D3X3, module_number, disc_number, disc_status) == true) return;
 	
   // Start of SPI data transfer
-  digitalWrite(_EN_PIN, LOW);
+  PinWrite(_EN_PIN, LOW);
 
  /* 
   * Send blank data "0" to all control outputs of the other displays BEFORE 
@@ -886,8 +1538,8 @@ void FlipDisc::Disc_3x3(uint8_t module_number, uint8_t disc_number, bool disc_st
   */
   for(int byte_number = 0; byte_number < 2; byte_number++)
   {
-	if(disc_status == 1) SPI.transfer(pgm_read_byte(&setDiscArray_3x3[disc_number][byte_number]));
-	if(disc_status == 0) SPI.transfer(pgm_read_byte(&resetDiscArray_3x3[disc_number][byte_number]));
+	if(disc_status == 1) SpiTransfer(pgm_read_byte(&setDiscArray_3x3[disc_number][byte_number]));
+	if(disc_status == 0) SpiTransfer(pgm_read_byte(&resetDiscArray_3x3[disc_number][byte_number]));
   }
    
  /* 
@@ -898,10 +1550,10 @@ void FlipDisc::Disc_3x3(uint8_t module_number, uint8_t disc_number, bool disc_st
   SendBlankData(module_number, D3X3, AFTER);
 
   // End of SPI data transfer
-  digitalWrite(_EN_PIN, HIGH);
+  PinWrite(_EN_PIN, HIGH);
 
   // Release of 1ms current pulse 
-  ReleaseCurrentPulse();
+  ReleaseCurrentPulse(D3X3, module_number, disc_number, disc_status);
 
   // Clear all outputs of the controllers built into the displays
   ClearAllOutputs();
@@ -929,6 +1581,9 @@ void FlipDisc::Display_3x3(uint8_t module_number, uint8_t new_data, uint8_t data
   * If the selected display has not been declared in Init() then the function will not execute.
   */
   if(Fuse(module_number, D3X3) == true) return;
+
+  // Symbols 0-11 only
+  if(new_data > 11) return;
   
   bool disc_status = 0;
   uint8_t bit_number = 0;
@@ -980,14 +1635,18 @@ void FlipDisc::Disc_3x4(uint8_t module_number, uint8_t disc_number, bool disc_st
 {
  /*
   * Simple protection from user error. 
-  * If the selected display has not been declared in Init() then the function will not execute.
+  * If the selected display has not been declared in Init() or the display 
+  * has no such disc then the function will not execute.
   */
-  if(Fuse(module_number, D3X4) == true) return;
+  if(DiscFuse(module_number, D3X4, disc_number) == true) return;
 
   disc_number = disc_number - 1;
+
+  // In the QUEUE mode the new disc status is only saved in the queue of pending flips
+  if(Queue(D3X4, module_number, disc_number, disc_status) == true) return;
 	
   // Start of SPI data transfer
-  digitalWrite(_EN_PIN, LOW);
+  PinWrite(_EN_PIN, LOW);
 
  /* 
   * Send blank data "0" to all control outputs of the other displays BEFORE 
@@ -1011,8 +1670,8 @@ void FlipDisc::Disc_3x4(uint8_t module_number, uint8_t disc_number, bool disc_st
   */
   for(int byte_number = 0; byte_number < 2; byte_number++)
   {
-    if(disc_status == 1) SPI.transfer(pgm_read_byte(&setDiscArray_3x4[disc_number][byte_number]));
-    if(disc_status == 0) SPI.transfer(pgm_read_byte(&resetDiscArray_3x4[disc_number][byte_number]));
+    if(disc_status == 1) SpiTransfer(pgm_read_byte(&setDiscArray_3x4[disc_number][byte_number]));
+    if(disc_status == 0) SpiTransfer(pgm_read_byte(&resetDiscArray_3x4[disc_number][byte_number]));
   }
    
  /* 
@@ -1023,10 +1682,10 @@ void FlipDisc::Disc_3x4(uint8_t module_number, uint8_t disc_number, bool disc_st
   SendBlankData(module_number, D3X4, AFTER);
 
   // End of SPI data transfer
-  digitalWrite(_EN_PIN, HIGH);
+  PinWrite(_EN_PIN, HIGH);
 
   // Release of 1ms current pulse 
-  ReleaseCurrentPulse();
+  ReleaseCurrentPulse(D3X4, module_number, disc_number, disc_status);
 
   // Clear all outputs of the controllers built into the displays
   ClearAllOutputs();
@@ -1054,6 +1713,9 @@ void FlipDisc::Disc_3x4(uint8_t module_number, uint8_t disc_number, bool disc_st
  *----------------------------------------------------------------------------------*/
 void FlipDisc::Display_3x4(uint8_t module_number, uint8_t row_number, uint8_t column_number, bool disc_status)
 {
+  // Rows 1-4 and columns 1-3 only
+  if((row_number < 1) || (row_number > 4) || (column_number < 1) || (column_number > 3)) return;
+  
   // Based on the row (1-4) and column (1-3) disc address, we determine the disc number 1-12
   uint8_t disc_number = (row_number - 1) * 3 + column_number;	
   
@@ -1079,14 +1741,18 @@ void FlipDisc::Display_3x4(uint8_t module_number, uint8_t row_number, uint8_t co
  * displayed are contained in two tables:                                           *
  * -> setDiscArray_3x5[][] - "1"                                                    *
  * -> resetDiscArray_3x5[][] - "0"                                                  *
+ * Returns the handle of the update - see FlipTask                                  *
  *----------------------------------------------------------------------------------*/
-void FlipDisc::Display_3x5(uint8_t module_number, uint8_t new_data)
+FlipTask FlipDisc::Display_3x5(uint8_t module_number, uint8_t new_data)
 {
  /*
   * Simple protection from user error. 
   * If the selected display has not been declared in Init() then the function will not execute.
   */
-  if(Fuse(module_number, D3X5) == true) return;
+  if(Fuse(module_number, D3X5) == true) return FlipTask();
+
+  // Symbols 0-67 only
+  if(new_data > 67) return FlipTask();
   
   bool disc_status = 0;
   uint8_t bit_number = 0;
@@ -1115,6 +1781,9 @@ void FlipDisc::Display_3x5(uint8_t module_number, uint8_t new_data)
   }
   // Finally, clear all display outputs
   ClearAllOutputs();
+
+  // The handle of the update, done at once in the DIRECT mode
+  return FlipTask(ModulePosition(module_number, D3X5));
 }
 
 /*----------------------------------------------------------------------------------*
@@ -1138,19 +1807,317 @@ void FlipDisc::Matrix_3x5(uint8_t data1, uint8_t data2 /* = 0xFF */, uint8_t dat
 }
 
 /*----------------------------------------------------------------------------------*
- * Function allows you to control a selected disc in a 3x5 display.                 *
- * We can control only one disc of the selected display at a time. The first        *
- * argument module_number is the relative number of the display in the series       *
- * of all displays. For example, if we have a combination of D3X5, D7SEG, D3X5,     *
- * then the second D3X5 display will have a relative number of 2 even though there  *
- * is a D7SEG display between the D3X5 displays.                                    *
- * -> module_number - relative number of the "D3X5" display                         *
- * -> disc_number - display disc number counting from left to right in each row     *
- * first row 1-3, second row 4-6, third row 7-9, four row 10-12, five 13-15 	    *
- * -> disc_status - reset disc "0" or set disc "1"                                  *  
- *	13 14 15                                                                    *
- *	10 11 12                                                                    *
- *	7  8  9                                                                     *
+ * The function selects the displays showing the text printed with print()          *
+ * and println(), e.g. Flip.print("12:34"), Flip.println(23.5, 1).                  *
+ * -> module_type - D7SEG or D3X5                                                   *
+ * -> module_number - relative number of the display showing the first character    *
+ *                                                                                  *
+ * Brief:                                                                           *
+ * Each character is shown on the next display of the selected type, the            *
+ * characters beyond the last display are skipped. The end of the line "\n"         *
+ * clears the rest of the displays and the next text starts again from the first    *
+ * display - println() shows the whole text. Lowercase letters are shown as         *
+ * uppercase, the characters without a symbol as HLA "≡" on the 7-segment           *
+ * displays and "?" on the 3x5 displays - see charArray_7Seg[] and charArray_3x5[]. *
+ * The text is UTF-8, "°", "¯" and "≡" are also shown.                              *
+ * In the DIRECT mode only the displays with a changed character are flipped.       *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::Text(uint8_t module_type, uint8_t module_number /* = 1 */)
+{
+  // Only the 7-segment and 3x5 displays can show the text
+  if((module_type != D7SEG) && (module_type != D3X5)) return;
+
+  text_type = module_type;
+  text_first = module_number;
+  text_cursor = module_number;
+  text_utf8_bytes = 0;
+  number_shown_valid = false;
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function moves the cursor of the text back to the first display selected     *
+ * by Text(), so the next print() overwrites the text from the start, e.g. before   *
+ * Flip.print(temperature) in loop(). The displays are not cleared.                 *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::Home(void)
+{
+  text_cursor = text_first;
+  text_utf8_bytes = 0;
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function shows the number right-aligned on the displays selected by Text(),  *
+ * e.g. Flip.Number(-235, 1, DEG) on 3x5 displays shows "-23.5°".                   *
+ * -> value - integer or fixed-point number, value x 10^decimals                    *
+ * -> decimals - number of the digits after the decimal point, always shown,        *
+ *    only on the 3x5 displays - the 7-segment displays have no dot, so 0           *
+ * -> unit - symbol shown after the number: DEG, C, F, etc. NONE - no unit          *
+ * Returns 1 if the number has been shown, 0 if not - see Hysteresis().             *
+ *                                                                                  *
+ * Brief:                                                                           *
+ * Negative numbers start with MIN "-", the displays before the number are          *
+ * cleared. The decimal point is shown as DOT "." on its own display. The number    *
+ * with decimals is not shown on the 7-segment displays (returns 0) - a number      *
+ * without its decimal point would read 10^decimals times too large. A number       *
+ * which does not fit the displays is shown as HLA "≡" on all displays.             *
+ * The displays with unchanged digits are not flipped - see Text().                 *
+ *----------------------------------------------------------------------------------*/
+bool FlipDisc::Number(int32_t value, uint8_t decimals /* = 0 */, uint8_t unit /* = NONE */)
+{
+ /*
+  * Simple protection from user error. 
+  * If there is no such symbol of the unit then the function will not execute.
+  */
+  if((text_type == D7SEG) && (unit > 45) && (unit != NONE)) return 0;
+  if((text_type == D3X5) && (unit > 67) && (unit != NONE)) return 0;
+  
+  // The 7-segment displays have no dot - 235 with 1 decimal would read 235, not 23.5
+  if((text_type == D7SEG) && (decimals > 0)) return 0;
+
+  if((number_shown_valid == true) && (decimals == number_decimals) && (unit == number_unit))
+  {
+    if(value == number_shown) 
+    {
+      number_candidate = value;
+      return 0;
+    }
+
+    // Difference of the signed numbers, exact in the range 0 - 0xFFFFFFFF
+    uint32_t difference = (value > number_shown) ? (uint32_t)value - (uint32_t)number_shown : (uint32_t)number_shown - (uint32_t)value;
+
+    // A small change is shown only if the new number stays for stable_time
+    if(difference < number_threshold)
+    {
+      if(value != number_candidate)
+      {
+        number_candidate = value;
+        number_candidate_time = clock_millis();
+        return 0;
+      }
+      
+      if(number_stable_time == 0) return 0;
+      if(clock_millis() - number_candidate_time < number_stable_time) return 0;
+    }
+  }
+
+  // Number of the displays of the selected type, starting from the first one
+  uint8_t number_displays = 0;
+  while((number_displays < 8) && (ModulePosition(text_first + number_displays, text_type) != 0xFF)) number_displays++;
+  if(number_displays == 0) return 0;
+
+  uint8_t symbolArray[8];
+  uint8_t position = number_displays;
+  uint8_t digits = 0;
+  uint32_t magnitude = (value < 0) ? 0 - (uint32_t)value : (uint32_t)value;
+  bool overflow = false;
+
+  for(int i = 0; i < number_displays; i++) symbolArray[i] = CLR;
+
+  // From the last display - the unit, the digits and the sign
+  if(unit != NONE) symbolArray[--position] = unit;
+  
+  do
+  {
+    // The decimal point before the integer part
+    if((decimals > 0) && (digits == decimals))
+    {
+      if(position == 0) {overflow = true; break;}
+      symbolArray[--position] = DOT;
+    }
+    
+    if(position == 0) {overflow = true; break;}
+    symbolArray[--position] = magnitude % 10;
+    magnitude = magnitude / 10;
+    digits = digits + 1;
+  } 
+  while((magnitude > 0) || (digits <= decimals));
+
+  if(value < 0)
+  {
+    if(position == 0) overflow = true;
+    else symbolArray[--position] = MIN;
+  }
+
+  if(overflow == true) 
+  {
+    for(int i = 0; i < number_displays; i++) symbolArray[i] = HLA;
+  }
+
+  text_cursor = text_first;
+  for(int i = 0; i < number_displays; i++) TextSymbol(symbolArray[i]);
+  text_cursor = text_first;
+
+  number_shown = value;
+  number_candidate = value;
+  number_decimals = decimals;
+  number_unit = unit;
+  number_shown_valid = true;
+
+  return 1;
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function sets the deadband of the numbers shown by Number(). Noisy readings  *
+ * of the sensors do not flip the last digit back and forth.                        *
+ * -> threshold - the smallest change shown at once, in units of the last digit,    *
+ *    0 or 1 - every change is shown (default)                                      *
+ * -> stable_time - a smaller change is shown if the new number stays for           *
+ *    stable_time milliseconds, 0 - smaller changes are never shown                 *
+ *                                                                                  *
+ * Brief:                                                                           *
+ * E.g. Hysteresis(3, 5000) with one decimal - the temperature 21.4° is shown at    *
+ * once after 21.0°, 21.1° only after 5 seconds of the same reading. The changes    *
+ * of decimals or unit and the first Number() after Text() are always shown.        *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::Hysteresis(uint32_t threshold, uint16_t stable_time /* = 0 */)
+{
+  number_threshold = threshold;
+  number_stable_time = stable_time;
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function shows one character (one byte of UTF-8 text) - see Text().          *
+ * Called by print() and println() of the Print class.                              *
+ * The cursor goes back to the first display only after "\n", Text(), Home() and    *
+ * Number() - print() without println() called again, e.g. in loop(), continues     *
+ * after the last display and its characters are skipped. Use println(), or call    *
+ * Home() before each print().                                                      *
+ *----------------------------------------------------------------------------------*/
+size_t FlipDisc::write(uint8_t character)
+{
+  // Continuation byte of the UTF-8 sequence - 10xxxxxx
+  if((character & 0xC0) == 0x80)
+  {
+    // Continuation byte without the first byte of the sequence is skipped
+    if(text_utf8_bytes == 0) return 1;
+
+    text_code_point = (text_code_point << 6) | (character & 0x3F);
+    text_utf8_bytes = text_utf8_bytes - 1;
+    
+    if(text_utf8_bytes == 0) TextCodePoint(text_code_point);
+    return 1;
+  }
+
+  // Incomplete UTF-8 sequence is shown as the character without a symbol
+  if(text_utf8_bytes > 0) 
+  {
+    text_utf8_bytes = 0;
+    TextCodePoint(0xFFFD);
+  }
+
+  // The first byte of the UTF-8 sequence - 110xxxxx, 1110xxxx or 11110xxx
+  if(character >= 0xC0)
+  {
+    if(character < 0xE0) {text_code_point = character & 0x1F; text_utf8_bytes = 1;}
+    else if(character < 0xF0) {text_code_point = character & 0x0F; text_utf8_bytes = 2;}
+    else if(character < 0xF8) {text_code_point = character & 0x07; text_utf8_bytes = 3;}
+    else TextCodePoint(0xFFFD);
+    return 1;
+  }
+
+  // The end of the line - clear the rest of the displays and start again from the first
+  if(character == '\n')
+  {
+    while(ModulePosition(text_cursor, text_type) != 0xFF) TextSymbol(CLR);
+    text_cursor = text_first;
+    return 1;
+  }
+
+  // "\r" and the other control characters are skipped
+  if(character < 0x20) return 1;
+
+  TextCodePoint(character);
+  return 1;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function finds the symbol of the character and shows it on the display       *
+ * pointed by the cursor - see Text().                                              *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::TextCodePoint(uint32_t code_point)
+{
+  uint8_t new_data = 0;
+
+  if((code_point >= 0x20) && (code_point < 0x80))
+  {
+    if(text_type == D7SEG) new_data = pgm_read_byte(&charArray_7Seg[code_point - 0x20]);
+    if(text_type == D3X5) new_data = pgm_read_byte(&charArray_3x5[code_point - 0x20]);
+  }
+  else if(code_point == 0x00B0) new_data = DEG;   // "°"
+  else if(code_point == 0x00AF) new_data = HLU;   // "¯"
+  else if(code_point == 0x2261) new_data = HLA;   // "≡"
+  else if(text_type == D7SEG) new_data = HLA;     // No symbol - "≡"
+  else new_data = 66;                             // No symbol - "?"/66/QST
+
+  // The separators ".", ":" and "," do not take a 7-segment display
+  if(new_data == NONE) return;
+
+  TextSymbol(new_data);
+
+  // "%" takes two 7-segment displays - the first half PFH and the second half PSH
+  if((text_type == D7SEG) && (code_point == '%')) TextSymbol(PSH);
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function shows the symbol on the display pointed by the cursor and moves     *
+ * the cursor to the next display. In the DIRECT mode the display is not flipped    *
+ * if it already shows the symbol, in the QUEUE mode the queue skips such discs.    *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::TextSymbol(uint8_t new_data)
+{
+  uint8_t module_position = ModulePosition(text_cursor, text_type);
+
+  // The characters beyond the last display are skipped
+  if(module_position == 0xFF) return;
+
+  if((update_mode != DIRECT) || (SymbolShown(module_position, new_data) == false))
+  {
+    if(text_type == D7SEG) Display_7Seg(text_cursor, new_data);
+    if(text_type == D3X5) Display_3x5(text_cursor, new_data);
+  }
+
+  text_cursor = text_cursor + 1;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function returns 1 if all discs of the 7-segment or 3x5 display are known    *
+ * and already show the symbol, see displayArray_7Seg[][] and displayArray_3x5[][]. *
+ *----------------------------------------------------------------------------------*/
+bool FlipDisc::SymbolShown(uint8_t module_position, uint8_t new_data)
+{
+  uint8_t module_type = moduleInitArray[module_position][module_type_column];
+  bool disc_status = 0;
+
+  for(int disc_number = 0; disc_number < moduleInitArray[module_position][number_discs_column]; disc_number++)
+  {
+    // Byte number "disc_number >> 3", bit number "disc_number & 0x07" - same as in Display_7Seg()
+    if(module_type == D7SEG) disc_status = ((pgm_read_byte(&displayArray_7Seg[new_data][disc_number >> 3])) >> (disc_number & 0x07)) & 0b00000001;
+    if(module_type == D3X5) disc_status = ((pgm_read_byte(&displayArray_3x5[new_data][disc_number >> 3])) >> (disc_number & 0x07)) & 0b00000001;
+
+    if(ReadDiscBit(discKnownArray, module_position, disc_number) == 0) return 0;
+    if(ReadDiscBit(discStateArray, module_position, disc_number) != disc_status) return 0;
+  }
+
+  return 1;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Function allows you to control a selected disc in a 3x5 display.                 *
+ * We can control only one disc of the selected display at a time. The first        *
+ * argument module_number is the relative number of the display in the series       *
+ * of all displays. For example, if we have a combination of D3X5, D7SEG, D3X5,     *
+ * then the second D3X5 display will have a relative number of 2 even though there  *
+ * is a D7SEG display between the D3X5 displays.                                    *
+ * -> module_number - relative number of the "D3X5" display                         *
+ * -> disc_number - display disc number counting from left to right in each row     *
+ * first row 1-3, second row 4-6, third row 7-9, four row 10-12, five 13-15 	    *
+ * -> disc_status - reset disc "0" or set disc "1"                                  *  
+ *	13 14 15                                                                    *
+ *	10 11 12                                                                    *
+ *	7  8  9                                                                     *
  *	4  5  6                                                                     *
  *	1  2  3                                                                     *
  *----------------------------------------------------------------------------------*/
@@ -1158,14 +2125,18 @@ void FlipDisc::Disc_3x5(uint8_t module_number, uint8_t disc_number, bool disc_st
 {
  /*
   * Simple protection from user error. 
-  * If the selected display has not been declared in Init() then the function will not execute.
+  * If the selected display has not been declared in Init() or the display 
+  * has no such disc then the function will not execute.
   */
-  if(Fuse(module_number, D3X5) == true) return;
+  if(DiscFuse(module_number, D3X5, disc_number) == true) return;
 
   disc_number = disc_number - 1;
+
+  // In the QUEUE mode the new disc status is only saved in the queue of pending flips
+  if(Queue(D3X5, module_number, disc_number, disc_status) == true) return;
 	
   // Start of SPI data transfer
-  digitalWrite(_EN_PIN, LOW);
+  PinWrite(_EN_PIN, LOW);
 
  /* 
   * Send blank data "0" to all control outputs of the other displays BEFORE 
@@ -1189,8 +2160,8 @@ void FlipDisc::Disc_3x5(uint8_t module_number, uint8_t disc_number, bool disc_st
   */
   for(int byte_number = 0; byte_number < 2; byte_number++)
   {
-    if(disc_status == 1) SPI.transfer(pgm_read_byte(&setDiscArray_3x5[disc_number][byte_number]));
-    if(disc_status == 0) SPI.transfer(pgm_read_byte(&resetDiscArray_3x5[disc_number][byte_number]));
+    if(disc_status == 1) SpiTransfer(pgm_read_byte(&setDiscArray_3x5[disc_number][byte_number]));
+    if(disc_status == 0) SpiTransfer(pgm_read_byte(&resetDiscArray_3x5[disc_number][byte_number]));
   }
    
  /* 
@@ -1201,10 +2172,10 @@ void FlipDisc::Disc_3x5(uint8_t module_number, uint8_t disc_number, bool disc_st
   SendBlankData(module_number, D3X5, AFTER);
 
   // End of SPI data transfer
-  digitalWrite(_EN_PIN, HIGH);
+  PinWrite(_EN_PIN, HIGH);
 
   // Release of 1ms current pulse 
-  ReleaseCurrentPulse();
+  ReleaseCurrentPulse(D3X5, module_number, disc_number, disc_status);
 
   // Clear all outputs of the controllers built into the displays
   ClearAllOutputs();
@@ -1232,14 +2203,18 @@ void FlipDisc::Disc_4x3x3( uint8_t module_number, uint8_t disc_number, bool disc
 {
  /*
   * Simple protection from user error. 
-  * If the selected display has not been declared in Init() then the function will not execute.
+  * If the selected display has not been declared in Init() or the display 
+  * has no such disc then the function will not execute.
   */
-  if(Fuse(module_number, D4X3X3) == true) return;
+  if(DiscFuse(module_number, D4X3X3, disc_number) == true) return;
 
   disc_number = disc_number - 1;
+
+  // In the QUEUE mode the new disc status is only saved in the queue of pending flips
+  if(Queue(D4X3X3, module_number, disc_number, disc_status) == true) return;
 	
   // Start of SPI data transfer
-  digitalWrite(_EN_PIN, LOW);
+  PinWrite(_EN_PIN, LOW);
 
  /* 
   * Send blank data "0" to all control outputs of the other displays BEFORE 
@@ -1263,8 +2238,8 @@ void FlipDisc::Disc_4x3x3( uint8_t module_number, uint8_t disc_number, bool disc
   */
   for(int byte_number = 0; byte_number < 3; byte_number++)
   {
-	if(disc_status == 1) SPI.transfer(pgm_read_byte(&setDiscArray_4x3x3[disc_number][byte_number]));
-	if(disc_status == 0) SPI.transfer(pgm_read_byte(&resetDiscArray_4x3x3[disc_number][byte_number]));
+	if(disc_status == 1) SpiTransfer(pgm_read_byte(&setDiscArray_4x3x3[disc_number][byte_number]));
+	if(disc_status == 0) SpiTransfer(pgm_read_byte(&resetDiscArray_4x3x3[disc_number][byte_number]));
   }
    
  /* 
@@ -1275,10 +2250,10 @@ void FlipDisc::Disc_4x3x3( uint8_t module_number, uint8_t disc_number, bool disc
   SendBlankData(module_number, D4X3X3, AFTER);
 
   // End of SPI data transfer
-  digitalWrite(_EN_PIN, HIGH);
+  PinWrite(_EN_PIN, HIGH);
 
   // Release of 1ms current pulse 
-  ReleaseCurrentPulse();
+  ReleaseCurrentPulse(D4X3X3, module_number, disc_number, disc_status);
 
   // Clear all outputs of the controllers built into the displays
   ClearAllOutputs(); 
@@ -1321,6 +2296,9 @@ void FlipDisc::Display_4x3x3(uint8_t module_number, uint8_t section_number, uint
   * If the selected display has not been declared in Init() then the function will not execute.
   */
   if(Fuse(module_number, D4X3X3) == true) return;
+
+  // Sections 1-4 and symbols 0-11 only
+  if((section_number < 1) || (section_number > 4) || (new_data > 11)) return;
   
   bool disc_status = 0;
   uint8_t bit_number = 0;
@@ -1370,13 +2348,20 @@ void FlipDisc::Display_4x3x3(uint8_t module_number, uint8_t section_number, uint
  *----------------------------------------------------------------------------------*/
 void FlipDisc::Test(void)
 {
-  uint8_t current_time_delay = flip_delay; // Save current time delay
+  uint32_t current_time_delay = flip_delay; // Save current time delay
+  uint8_t current_delay_mask = module_delay_mask; // Save the modules with own time delay
+  uint8_t current_update_mode = update_mode; // Save current update mode
 
+  Mode(DIRECT);                             // The test always flips discs immediately
   Delay(100);                               // Change flip delay time to 100 
+  flip_forced = true;                       // Pulse also the discs already showing the status
   Clear();                                  // Clear all displays               
   All();                                    // Set all discs of all displays 
   Clear();                                  // Clear all displays 
-  Delay(current_time_delay);                // Restore current time delay
+  flip_forced = false;
+  DelayMicros(current_time_delay);          // Restore current time delay
+  module_delay_mask = current_delay_mask;   // Restore the modules with own time delay
+  Mode(current_update_mode);                // Restore current update mode
 }
 
 /*----------------------------------------------------------------------------------*
@@ -1520,147 +2505,2286 @@ void FlipDisc::Clear(void)
 }
 
 /*----------------------------------------------------------------------------------*
- * The function is used to configure the control pins                               *
+ * The function is used to select how the display functions flip the discs          *
+ * -> DIRECT - default mode, each call flips the discs immediately, except          *
+ *    the discs which already show the new status (see Unknown())                   *
+ * -> QUEUE - calls of the display functions only save the new disc statuses        *
+ *    in the queue of pending flips and return immediately. The queue is keyed      *
+ *    by module and disc, so a newer status of the disc replaces the pending one    *
+ *    or cancels it if the disc already shows this status. Pending flips are        *
+ *    released by the Flush() function.                                             *
+ * Switching back to the DIRECT mode ends the frame being written (see FrameRate()) *
+ * and releases all pending flips first.                                            *
  *----------------------------------------------------------------------------------*/
-void FlipDisc::Pin(uint16_t EN_PIN, uint16_t CH_PIN, uint16_t PL_PIN)
+void FlipDisc::Mode(uint8_t new_update_mode)
 {
-  // Release the current pulse - turn ON/OFF
-  pinMode(PL_PIN, OUTPUT);
-  _PL_PIN = PL_PIN;
-  digitalWrite(_PL_PIN, LOW);
-
-  // Charging PSPS module - turn ON/OFF
-  pinMode(CH_PIN, OUTPUT);
-  _CH_PIN = CH_PIN;
-  digitalWrite(_CH_PIN, LOW);
+  if(new_update_mode == QUEUE) update_mode = QUEUE;
+  else
+  {
+    // The frame being written is complete, it must not overwrite the later direct flips
+    if((update_mode == QUEUE) && (frame_interval > 0)) Frame();
+    update_mode = DIRECT;
+    Flush();
+  }
   
-  // Start & End SPI transfer data
-  pinMode(EN_PIN, OUTPUT);
-  _EN_PIN = EN_PIN;
-  digitalWrite(_EN_PIN, LOW);  
+  queue_input = (update_mode == QUEUE);
 }
 
 /*----------------------------------------------------------------------------------*
- * The function is used to set the delay effect between flip discs                  *
- * The default value without calling the function is 0                              *
- * Recommended delay range: 0 - 100ms, max 255ms                                    *
+ * The function flips all discs waiting in the queue of pending flips.              *
+ * The discs are flipped in the order of the modules in the series.                 *
  *----------------------------------------------------------------------------------*/
-void FlipDisc::Delay(uint8_t new_time_delay)
+void FlipDisc::Flush(void)
 {
-  flip_delay = new_time_delay;  
-}
+  FrameToQueue(true);
+  TaskDone();
+  if(Pending() == 0) return;
 
-/*----------------------------------------------------------------------------------*
- * Private function                                                                 *
- * The function is used to check whether the number (module_number) of the selected *
- * display (module_type) exists.                                                    *
- * For example, if the display no.3 (module_number) of a specific type (module_type)*
- * was selected and earlier in the Init() function we declared fewer or no displays *
- * of the selected type (module_type), the function returns 1 - the fuse has tripped*
- *----------------------------------------------------------------------------------*/
-bool FlipDisc::Fuse(uint8_t module_number, uint8_t module_type)
-{
-  uint8_t highest_module_number = 0;
-  
-  for(int i = 0; i < 8; i++)
+  while(DeadlineWait() == true)
   {
-    if(moduleInitArray[i][module_type_column] == module_type) highest_module_number = highest_module_number + 1;
+    // Wait for the start of the frame with a deadline, the deadlines are set in ms
+    ClockIdle(1000);
   }
   
-  if(highest_module_number < module_number) return 1;
-  else return 0;
+  while(Pending() > 0)
+  {
+    // Flip the discs one by one until the queue is empty, 
+    // wait if all displays with pending flips wait for their delay effect
+    if(FlipNextQueuedDisc() == false) ClockIdle(QueueGapWait());
+  }
+
+  // Finally, clear all display outputs
+  ClearQueueOutputs();
+
+  // Flush() waits for the whole update anyway, the EEPROM is saved now
+  EepromSave();
 }
 
 /*----------------------------------------------------------------------------------*
- * Private function                                                                 *
- * The function is used to wait between flip discs                                  *
- * Recommended delay range: 0 - 100ms, max 255ms                                    *
+ * The function flips only one disc waiting in the queue of pending flips           *
+ * and returns immediately. Returns 1 if a disc has been flipped, 0 - the queue     *
+ * is empty or all displays with pending flips wait for their delay effect.         *
+ * The update in progress can be retargeted between the steps:                      *
+ * new display calls in the QUEUE mode replace the pending disc statuses and        *
+ * the remaining flips are recalculated against the discs already flipped,          *
+ * the flips for the stale content are dropped immediately.                         *
  *----------------------------------------------------------------------------------*/
-void FlipDisc::FlipDelay(void)
+bool FlipDisc::Step(void)
 {
-  time_now = millis();
+  FrameToQueue(false);
+  TaskDone();
+  if(DeadlineWait() == true) return 0;
   
-  while(millis() - time_now < flip_delay)
+  if(FlipNextQueuedDisc() == false)
   {
-    // Do nothing and wait
-  }  
+    // Idle time - the refresh pulse is not counted as a flip of the queue
+    if((Pending() == 0) && (RefreshNextDisc() == true)) ClearQueueOutputs();
+    return 0;
+  }
+  
+  // Clear all display outputs before returning to the user code
+  ClearQueueOutputs();
+
+  return 1;
 }
 
 /*----------------------------------------------------------------------------------*
- * Private function                                                                 *
- * The function is used to sending empty data to complete the control data string.  *
- * -> module_number - (1-8) the relative position of the display in relation        *
- *    to the displays of the selected type                                          *
- * -> module_type - (D7SEG, D2X1, D3X1, D1X3, D1X7) selected display type           *
- * -> data_position - ("BEFORE", "AFTER") order of sending data, BEFORE control data*
- *    or AFTER control data.                                                        *
- *                                                                                  *
- * Brief:                                                                           *
- * First, based on the arguments, the function determines the absolute position     *
- * of the selected display in the series of all displays. Then, based on the        *
- * information about the types of displays BEFORE or AFTER the currently selected   *
- * display, it prepares an empty data frame "0" and sends this data.                *
- * For proper control of the display, the so-called empty supplementary data frames *
- * are absolutely necessary!                                                        *
- * The point is that we can only control one disc out of all connected display      *
- * modules at a time. So in the entire data frame for e.g. eight 7-Segment displays,* 
- * for 24 bytes of data there are only 2 bits set to "1" and the remaining 190 bits *
- * must be set to "0".                                                              *
- * The architecture of the embedded display controller requires it.                 *
+ * The function flips the discs waiting in the queue of pending flips, but only     *
+ * as many as fit in the given time, and returns the number of discs still waiting. *
+ * Calling the function from loop() spreads a long update, e.g. Clear() of          *
+ * a chain of 4x3x3 displays, over many loop iterations with a bound on the time    *
+ * spent in each call, so watchdog and serial handling are never starved.           *
+ * -> max_us - maximum time of the call in microseconds. The next disc is flipped   *
+ *    only if the time of one flip fits in the remaining time, but at least         *
+ *    one disc is flipped in each call, so max_us below the time of one flip        *
+ *    (about 1.1ms) results in one flip per call.                                   *
+ * The flip-rate governor is not waited for - if it does not release the next flip  *
+ * within the remaining time, the function returns and the flip is done later.      *
+ * The delay effect between flip discs is never waited for - the discs of other     *
+ * displays are flipped in the meantime, or the function returns and the user       *
+ * code runs until the next disc can be flipped.                                    *
+ * In idle time the refresh sweep and the saving of the wear counters and           *
+ * the state are done, one EEPROM byte at a time, only if they fit in max_us.       *
+ * The first flip after a state save clears the marker of the saved state (about    *
+ * 3.4ms on AVR, a commit of about 50ms on ESP32/ESP8266) - if it does not fit      *
+ * with the flip, the call clears the marker only and the flip is done later.       *
  *----------------------------------------------------------------------------------*/
-void FlipDisc::SendBlankData(uint8_t module_number, uint8_t module_type, uint8_t data_position)
+uint16_t FlipDisc::Service(uint32_t max_us)
 {
-  uint8_t empty_byte = 0;
+  uint32_t service_start = clock_micros();
+  uint16_t number_flips = 0;
 
-  for(int module_absolute_position = 0; module_absolute_position < 8; module_absolute_position++)
-  {  
-    // Look for the selected display type
-    if(moduleInitArray[module_absolute_position][module_type_column] == module_type)
-    { 
-     /*
-      * Then look for a specific display based on a relative number from a series 
-      * of displays of the same type. Based on these two parameters "module_number" and 
-      * "module_type" we determined the absolute position of the display "module_absolute_position". 
-      * Then, based on the absolute position of the display, we calculate the empty data frame "0"
-      * and sending this data.
-      */
-      if(moduleInitArray[module_absolute_position][module_relative_position_column] == module_number)
-      {       
-        if(data_position == BEFORE)
-        {
-          // In the calculation, we omit the currently selected display "(module_absolute_position + 1)"
-          for(int i = (module_absolute_position + 1); i < 8; i++) empty_byte = moduleInitArray[i][number_bytes_column] + empty_byte;     
-          for(int j = 0; j < empty_byte; j++) SPI.transfer(0);
-          return;     
-        }
-        
-        if(data_position == AFTER)
-        {
-          // In the calculation, we omit the currently selected display "(module_absolute_position - 1)"
-          for(int i = 0; i <= (module_absolute_position - 1); i++) empty_byte = moduleInitArray[i][number_bytes_column] + empty_byte;
-          for(int j = 0; j < empty_byte; j++) SPI.transfer(0);
-          return;      
-        }
+  FrameToQueue(false);
+  TaskDone();
+
+  while((Pending() > 0) && (DeadlineWait() == false))
+  {
+    uint32_t service_time = clock_micros() - service_start;
+    uint32_t flip_wait = FlipRateWait();
+    uint32_t clear_time = StateClearTime();
+    
+    if(service_time + flip_wait + clear_time + PulseTime() > max_us)
+    {
+      // Count the flip held back by the flip-rate governor only once
+      if((flip_wait > 0) && (flip_held == false))
+      {
+        throttle_count = throttle_count + 1;
+        flip_held = true;
+        flip_held_time = clock_micros();
+        flip_held_wait = flip_wait;
+      }
+      
+      if((number_flips > 0) || (flip_wait > 0)) break;
+      
+      // The marker of the saved state does not fit with the flip - the only work of this call
+      if(clear_time > 0)
+      {
+        StateClear();
+        break;
       }
     }
-  }   
+    
+    if(FlipNextQueuedDisc() == false) break;
+    number_flips = number_flips + 1;
+  }
+
+  // Idle time - one disc of the integrity refresh sweep
+  if((number_flips == 0) && (Pending() == 0) && (clock_micros() - service_start + PulseTime() <= max_us))
+  {
+    number_flips = RefreshNextDisc();
+  }
+
+  // Idle time - saving the wear counters and the state byte by byte in the remaining time
+  while((number_flips == 0) && (Pending() == 0))
+  {
+    uint32_t service_time = clock_micros() - service_start;
+    if(service_time >= max_us) break;
+    if(WearSaveStep(max_us - service_time) == true) continue;
+    if(StateSaveStep(max_us - service_time) == false) break;
+  }
+
+  // Clear all display outputs before returning to the user code
+  if(number_flips > 0) ClearQueueOutputs();
+
+  return Pending();
 }
 
 /*----------------------------------------------------------------------------------*
- * Private function                                                                 *
- * This function is used to disable all outputs of all displays in order to protect *
- * the displays against incorrect control or failure of the power module.           *
+ * The function limits the rate at which frames submitted in the QUEUE mode are     *
+ * displayed. The display calls between two Frame() calls make one frame, which     *
+ * is moved to the queue of pending flips at most frames_per_second times           *
+ * per second by the Step() and Service() functions (Flush() does not wait).        *
+ * If the display cannot keep up, intermediate frames are dropped and the display   *
+ * always converges to the newest frame, so the user code and the display run      *
+ * at their own speeds.                                                             *
+ * The frame buffer (320 bytes of RAM) is allocated by the first call with a limit. *
+ * Returns 0 if there is not enough RAM for the frame buffer, the frame rate is     *
+ * then not limited.                                                                *
+ * -> frames_per_second - 0 - frame rate not limited, display calls go directly     *
+ *    to the queue of pending flips                                                 *
  *----------------------------------------------------------------------------------*/
-void FlipDisc::ClearAllOutputs(void)
+bool FlipDisc::FrameRate(uint8_t frames_per_second)
 {
-  // Start of SPI data transfer
-  digitalWrite(_EN_PIN, LOW);
+  if(frames_per_second == 0)
+  {
+    // Move the waiting frames to the queue before the limit is removed
+    if(frame_interval > 0) Frame();
+    FrameToQueue(true);
+    frame_interval = 0;
+    return 1;
+  }
+
+  if(frameMaskArray == NULL)
+  {
+    frameTargetArray = (uint8_t (*)[8][5])calloc(frame_buffer_size, sizeof(*frameTargetArray));
+    frameMaskArray = (uint8_t (*)[8][5])calloc(frame_buffer_size, sizeof(*frameMaskArray));
+
+    if((frameTargetArray == NULL) || (frameMaskArray == NULL))
+    {
+      free(frameTargetArray);
+      free(frameMaskArray);
+      frameTargetArray = NULL;
+      frameMaskArray = NULL;
+      return 0;
+    }
+  }
+  
+  frame_interval = 1000 / frames_per_second;
+  return 1;
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function marks the end of the frame - all display calls since the previous   *
+ * Frame() call make one complete frame, ready to be displayed.                     *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::Frame(void)
+{
+  // With the driver task running, the end of the frame is passed to the driver task
+  if(DriverInput() == true)
+  {
+    DriverPush(0, 0xFF, 0);
+    return;
+  }
+  
+  if(frame_interval == 0) return;
+  
+  uint8_t frame_limit = 1;
+  if(lookahead_hold > 0) frame_limit = frame_buffer_size - 1;
+
+  // The buffer is full - the oldest waiting frame is overwritten by the next one
+  if(frame_count >= frame_limit)
+  {
+    uint8_t frame_next = (frame_first + 1) % frame_buffer_size;
+
+    DriverLock();
+    for(int module_position = 0; module_position < 8; module_position++)
+    {
+      for(int byte_number = 0; byte_number < 5; byte_number++)
+      {
+        uint8_t frame_mask = frameMaskArray[frame_first][module_position][byte_number];
+        uint8_t next_mask = frameMaskArray[frame_next][module_position][byte_number];
+
+        // Discs not changed by the next frame keep the statuses of the dropped frame
+        frameTargetArray[frame_next][module_position][byte_number] = 
+          (frameTargetArray[frame_next][module_position][byte_number] & next_mask) |
+          (frameTargetArray[frame_first][module_position][byte_number] & frame_mask & ~next_mask);
+        frameMaskArray[frame_next][module_position][byte_number] = next_mask | frame_mask;
+        frameMaskArray[frame_first][module_position][byte_number] = 0;
+      }
+    }
+    DriverUnlock();
+
+    frame_first = frame_next;
+    frame_count = frame_count - 1;
+    frames_dropped = frames_dropped + 1;
+  }
+
+  frame_count = frame_count + 1;
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function returns the number of frames overwritten by a newer frame           *
+ * before they were displayed.                                                      *
+ *----------------------------------------------------------------------------------*/
+uint32_t FlipDisc::FramesDropped(void)
+{
+  return frames_dropped;
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function enables the lookahead planner for the frames submitted with         *
+ * the frame rate limit. Up to three complete frames wait in the buffer and         *
+ * a flip which would be reverted by one of them sooner than hold_time after it     *
+ * is displayed is skipped - the disc keeps its status and two current pulses       *
+ * are saved. The display lags the submitted frames by the waiting frames.          *
+ * -> hold_time - minimum time in ms for which a flipped disc must keep its status, *
+ *    0 - planner disabled                                                          *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::Lookahead(uint16_t hold_time)
+{
+  lookahead_hold = hold_time;
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function returns the number of current pulses saved by the lookahead        *
+ * planner.                                                                         *
+ *----------------------------------------------------------------------------------*/
+uint32_t FlipDisc::PulsesSaved(void)
+{
+  return pulses_saved;
+}
+
+#if defined(ARDUINO_ARCH_ESP32)
+/*----------------------------------------------------------------------------------*
+ * ESP32 only. The function starts the driver task, which from now on owns          *
+ * the SPI bus and the EN, CH, PL pins and flips all discs, e.g. on the core        *
+ * not used by the application. The display functions and Frame() can then be       *
+ * called from any task on any core - the disc commands are passed to the driver    *
+ * task through a lock-free queue and the calling task never waits for the pulses   *
+ * (only if the queue of 64 commands is full). The FlipTask handles can be used     *
+ * from any task too, the OnDone() callbacks are called by the driver task.         *
+ * The functions which flip the discs directly (Test(), Mode(), Flush(), Step(),    *
+ * Service()) and Unknown() must not be called after the driver task has been       *
+ * started.                                                                         *
+ * Returns 1 if the driver task is running.                                         *
+ * -> driver_core - 0 or 1, the core of the driver task                             *
+ * -> driver_priority - FreeRTOS priority of the driver task                        *
+ *----------------------------------------------------------------------------------*/
+bool FlipDisc::Driver(uint8_t driver_core /* = 0 */, uint8_t driver_priority /* = 1 */)
+{
+  if(driver_task != NULL) return 1;
+
+  for(int slot_number = 0; slot_number < driver_queue_size; slot_number++) driverQueueArray[slot_number].sequence = slot_number;
+  
+  // The driver task works in the QUEUE mode
+  Mode(QUEUE);
+  
+  xTaskCreatePinnedToCore(DriverTask, "FlipDisc", 4096, this, driver_priority, &driver_task, driver_core);
+  
+  return (driver_task != NULL);
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The driver task - takes the disc commands from the driver queue and flips        *
+ * the discs in short slices, so the other tasks of the core are not starved.       *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::DriverTask(void *driver_parameters)
+{
+  FlipDisc *flip_disc = (FlipDisc *)driver_parameters;
+  
+  for(;;)
+  {
+    flip_disc->DriverPull();
+    flip_disc->Service(5000);
+
+    // Let the other tasks of the core run between the slices
+    vTaskDelay(1);
+  }
+}
+#endif
+
+/*----------------------------------------------------------------------------------*
+ * The function enables the integrity refresh sweep. In idle time, when Step() or   *
+ * Service() find no pending flips, one disc with known status is re-pulsed         *
+ * to its saved status every refresh_interval ms, disc by disc and display          *
+ * by display. The discs knocked out of their status, e.g. by vibration, are        *
+ * restored without a full redraw. The sweep pauses as soon as there are pending    *
+ * flips, so the live updates are never delayed by more than one pulse.            *
+ * -> new_refresh_interval - time between the refresh pulses in ms,                 *
+ *    0 - sweep disabled (default)                                                  *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::Refresh(uint16_t new_refresh_interval)
+{
+  refresh_interval = new_refresh_interval;
+  refresh_time = clock_millis();
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function marks the status of all discs of all displays as unknown,          *
+ * e.g. after a suspected power glitch. See Unknown() for the selected discs.       *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::Unknown(void)
+{
+  for(int module_position = 0; module_position < 8; module_position++)
+  {
+    for(int disc_number = 0; disc_number < moduleInitArray[module_position][number_discs_column]; disc_number++)
+    {
+      UnknownDisc(module_position, disc_number);
+    }
+  }
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function marks the status of the selected discs as unknown, e.g. after       *
+ * a suspected power glitch or a disc moved by hand. A disc with unknown status     *
+ * is always flipped at the next write, a disc with known status only when its      *
+ * status changes. In the QUEUE mode the discs are also queued to be flipped        *
+ * again to their last status, so only the selected discs are refreshed instead     *
+ * of the whole display with Test(). Must not be called after Driver().             *
+ * -> module_type - D7SEG, D3X1, ...                                                *
+ * -> module_number - relative number of the display                                *
+ * -> first_disc - the first disc numbered as in the Disc_...() function of         *
+ *    the display: 0-22 for D7SEG, from 1 for other displays,                       *
+ *    0xFF - all discs of the display (default)                                     *
+ * -> last_disc - the last disc, 0xFF - only the first disc (default)               *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::Unknown(uint8_t module_type, uint8_t module_number, uint8_t first_disc /* = 0xFF */, uint8_t last_disc /* = 0xFF */)
+{
+  uint8_t module_position = ModulePosition(module_number, module_type);
+  if(module_position == 0xFF) return;
+
+  uint8_t number_discs = moduleInitArray[module_position][number_discs_column];
+  if(number_discs == 0) return;
+  
+  if(first_disc == 0xFF)
+  {
+    first_disc = 0;
+    last_disc = number_discs - 1;
+  }
+  else
+  {
+    if(last_disc == 0xFF) last_disc = first_disc;
+    
+    if(module_type != D7SEG)
+    {
+      if((first_disc == 0) || (last_disc == 0)) return;
+      
+      first_disc = first_disc - 1;
+      last_disc = last_disc - 1;
+    }
+  }
+
+  if(last_disc >= number_discs) last_disc = number_discs - 1;
+
+  for(int disc_number = first_disc; disc_number <= last_disc; disc_number++)
+  {
+    UnknownDisc(module_position, disc_number);
+  }
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function sets the callback called after each released current pulse,        *
+ * in the DIRECT and QUEUE mode, e.g. to sequence the audio clicks exactly          *
+ * with the physical flips. The callback must be short and must not call            *
+ * the display functions.                                                           *
+ * -> flip_callback - function with the arguments:                                  *
+ *    module_type - D7SEG, D3X1, ...                                                *
+ *    module_number - relative number of the display                                *
+ *    disc_number - disc number counting from 0 for all display types               *
+ *    disc_status - the new status of the disc                                      *
+ *    flip_time - micros() at the end of the current pulse                          *
+ *    NULL - no callback                                                            *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::OnFlip(void (*new_flip_callback)(uint8_t module_type, uint8_t module_number, uint8_t disc_number, bool disc_status, uint32_t flip_time))
+{
+  flip_callback = new_flip_callback;
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function sets the callback called in the QUEUE mode after the last disc      *
+ * of the frame has been flipped - the frame is physically shown. A frame is        *
+ * the content moved to the queue by Frame() with the frame rate limit,             *
+ * otherwise all flips queued since the queue was empty.                            *
+ * -> frame_callback - function without arguments, NULL - no callback              *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::OnFrame(void (*new_frame_callback)(void))
+{
+  frame_callback = new_frame_callback;
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function sets the callback called in the QUEUE mode after the last disc      *
+ * has been flipped and no complete frames wait in the frame buffer.                *
+ * -> empty_callback - function without arguments, NULL - no callback              *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::OnEmpty(void (*new_empty_callback)(void))
+{
+  empty_callback = new_empty_callback;
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function sets the priority of the selected display in the queue of pending   *
+ * flips. Pending flips of displays with a higher priority are always done before   *
+ * the flips of displays with a lower priority, e.g. the seconds digit or an alarm  *
+ * dot stay responsive during a large background update. Displays with the same     *
+ * priority are handled in the order of the series. Default priority is 0.          *
+ * -> module_type - D7SEG, D3X1, ...                                                *
+ * -> module_number - relative number of the display                                *
+ * -> priority - 0-255, higher number - higher priority                             *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::Priority(uint8_t module_type, uint8_t module_number, uint8_t priority)
+{
+  uint8_t module_position = ModulePosition(module_number, module_type);
+  if(module_position == 0xFF) return;
+
+  moduleInitArray[module_position][module_priority_column] = priority;
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function sets the deadline of the frame saved in the queue - the moment      *
+ * (millis) at which the frame should become visible, e.g. the next second          *
+ * of a clock. Based on the number of pending flips and the time of one flip        *
+ * (charging + current pulse + delay effect) the Flush(), Step() and Service()      *
+ * functions delay the start of the update, so the last disc is flipped             *
+ * at the deadline.                                                                 *
+ * The deadline is cleared when the queue becomes empty.                            *
+ * -> visible_at - millis() value at which the frame should be visible              *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::Deadline(uint32_t visible_at)
+{
+  frame_deadline = visible_at;
+  frame_deadline_set = true;
+  frame_started = false;
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function returns how much the last frame with a deadline missed it by.       *
+ * The time of the last flip of the frame minus its deadline in milliseconds:       *
+ * > 0 - the frame was late, < 0 - the frame was early.                             *
+ *----------------------------------------------------------------------------------*/
+int32_t FlipDisc::DeadlineMiss(void)
+{
+  return deadline_miss;
+}
+
+/*----------------------------------------------------------------------------------*
+ * The functions estimate how long, in microseconds, the transition from            *
+ * the current content of the selected display to the new symbol will take.         *
+ * The arguments are the same as for the corresponding display functions.           *
+ *                                                                                  *
+ * Brief:                                                                           *
+ * Number of flips x time of one flip (charging + current pulse + delay effect).    *
+ * Only the discs that differ from the status saved by the library are flipped      *
+ * - the Hamming distance between the shown and the new symbol, discs with          *
+ * unknown status are counted as flips. 0 - the display has not been declared       *
+ * or there is no such symbol or data type. The estimate is against the known       *
+ * state of the discs (the last flipped status), not against the targets still      *
+ * pending in the QUEUE mode - with an update of the display in the queue           *
+ * the real number of flips may differ.                                             *
+ *----------------------------------------------------------------------------------*/
+uint32_t FlipDisc::Estimate_7Seg(uint8_t module_number, uint8_t new_data)
+{
+  uint8_t module_position = ModulePosition(module_number, D7SEG);
+  if((module_position == 0xFF) || (new_data > 45)) return 0;
+
+  uint8_t number_flips = 0;
+  bool disc_status = 0;
+  
+  for(int disc_number = 0; disc_number < 23; disc_number++)
+  {
+    // Byte number "disc_number >> 3", bit number "disc_number & 0x07" - same as in Display_7Seg()
+    disc_status = ((pgm_read_byte(&displayArray_7Seg[new_data][disc_number >> 3])) >> (disc_number & 0x07)) & 0b00000001;
+    number_flips = number_flips + FlipNeeded(module_position, disc_number, disc_status);
+  }
+
+  return number_flips * FlipTime(module_position);
+}
+
+uint32_t FlipDisc::Estimate_3x3(uint8_t module_number, uint8_t new_data, uint8_t data_type)
+{
+  uint8_t module_position = ModulePosition(module_number, D3X3);
+  if((module_position == 0xFF) || (new_data > 11)) return 0;
+  if((data_type != DICE) && (data_type != NUMB)) return 0;
+
+  uint8_t number_flips = 0;
+  bool disc_status = 0;
+  
+  for(int disc_number = 0; disc_number < 9; disc_number++)
+  {
+    if(data_type == DICE) disc_status = ((pgm_read_byte(&diceArray_3x3[new_data][disc_number >> 3])) >> (disc_number & 0x07)) & 0b00000001;
+    if(data_type == NUMB) disc_status = ((pgm_read_byte(&numbArray_3x3[new_data][disc_number >> 3])) >> (disc_number & 0x07)) & 0b00000001;
+    number_flips = number_flips + FlipNeeded(module_position, disc_number, disc_status);
+  }
+
+  return number_flips * FlipTime(module_position);
+}
+
+uint32_t FlipDisc::Estimate_3x5(uint8_t module_number, uint8_t new_data)
+{
+  uint8_t module_position = ModulePosition(module_number, D3X5);
+  if((module_position == 0xFF) || (new_data > 67)) return 0;
+
+  uint8_t number_flips = 0;
+  bool disc_status = 0;
+  
+  for(int disc_number = 0; disc_number < 15; disc_number++)
+  {
+    disc_status = ((pgm_read_byte(&displayArray_3x5[new_data][disc_number >> 3])) >> (disc_number & 0x07)) & 0b00000001;
+    number_flips = number_flips + FlipNeeded(module_position, disc_number, disc_status);
+  }
+
+  return number_flips * FlipTime(module_position);
+}
+
+uint32_t FlipDisc::Estimate_4x3x3(uint8_t module_number, uint8_t section_number, uint8_t new_data, uint8_t data_type)
+{
+  uint8_t module_position = ModulePosition(module_number, D4X3X3);
+  if((module_position == 0xFF) || (section_number < 1) || (section_number > 4) || (new_data > 11)) return 0;
+  if((data_type != DICE) && (data_type != NUMB)) return 0;
+
+  uint8_t number_flips = 0;
+  bool disc_status = 0;
+  
+  for(int disc_number = 0; disc_number < 9; disc_number++)
+  {
+    if(data_type == DICE) disc_status = ((pgm_read_byte(&diceArray_4x3x3[new_data][disc_number >> 3])) >> (disc_number & 0x07)) & 0b00000001;
+    if(data_type == NUMB) disc_status = ((pgm_read_byte(&numbArray_4x3x3[new_data][disc_number >> 3])) >> (disc_number & 0x07)) & 0b00000001;
+    
+    // Each of the 3x3 display sections is numbered the same way, shift the disc number by 9
+    number_flips = number_flips + FlipNeeded(module_position, disc_number + 9 * (section_number - 1), disc_status);
+  }
+
+  return number_flips * FlipTime(module_position);
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function returns the number of discs waiting in the queue of pending flips.  *
+ *----------------------------------------------------------------------------------*/
+uint16_t FlipDisc::Pending(void)
+{
+  uint16_t pending_flips = 0;
+  
+  for(int module_position = 0; module_position < 8; module_position++)
+  {
+    for(int disc_number = 0; disc_number < moduleInitArray[module_position][number_discs_column]; disc_number++)
+    {
+      pending_flips = pending_flips + ReadDiscBit(discPendingArray, module_position, disc_number);
+    }
+  }
+
+  return pending_flips;
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function is used to configure the control pins                               *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::Pin(uint16_t EN_PIN, uint16_t CH_PIN, uint16_t PL_PIN)
+{
+  // Release the current pulse - turn ON/OFF
+  pinMode(PL_PIN, OUTPUT);
+  _PL_PIN = PL_PIN;
+  PinWrite(_PL_PIN, LOW);
+
+  // Charging PSPS module - turn ON/OFF
+  pinMode(CH_PIN, OUTPUT);
+  _CH_PIN = CH_PIN;
+  PinWrite(_CH_PIN, LOW);
+  
+  // Start & End SPI transfer data
+  pinMode(EN_PIN, OUTPUT);
+  _EN_PIN = EN_PIN;
+  PinWrite(_EN_PIN, LOW);  
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function is used to set the delay effect between flip discs                  *
+ * The default value without calling the function is 0                              *
+ * Recommended delay range: 0 - 100ms, max 255ms                                    *
+ * The delay is set for all displays, also those with their own delay effect        *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::Delay(uint8_t new_time_delay)
+{
+  DelayMicros((uint32_t)new_time_delay * 1000);
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function is used to set the delay effect between flip discs                  *
+ * in microseconds, e.g. for fast effects below 1ms                                 *
+ * The default value without calling the function is 0                              *
+ * The delay is set for all displays, also those with their own delay effect        *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::DelayMicros(uint32_t new_time_delay)
+{
+  flip_delay = new_time_delay;
+  module_delay_mask = 0;
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function is used to set the delay effect between flip discs of one           *
+ * selected display, e.g. a slow cascading effect on a decorative 1x7 display       *
+ * while the 7-segment digits are updated as fast as possible. In the QUEUE mode    *
+ * the discs of the other displays are flipped while the selected display waits.    *
+ * The delay can be changed before each display call - in the QUEUE mode            *
+ * the delay at the time of the flip is used.                                       *
+ * -> module_type - D7SEG, D3X1, ...                                                *
+ * -> module_number - relative number of the display                                *
+ * -> new_time_delay - 0 - 255ms                                                    *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::Delay(uint8_t module_type, uint8_t module_number, uint8_t new_time_delay)
+{
+  DelayMicros(module_type, module_number, (uint32_t)new_time_delay * 1000);
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function is used to set the delay effect between flip discs of one           *
+ * selected display in microseconds.                                                *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::DelayMicros(uint8_t module_type, uint8_t module_number, uint32_t new_time_delay)
+{
+  uint8_t module_position = ModulePosition(module_number, module_type);
+  if(module_position == 0xFF) return;
+
+  moduleDelayArray[module_position] = new_time_delay;
+  module_delay_mask = module_delay_mask | (1 << module_position);
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function is used to configure the flip-rate governor which protects          *
+ * the Pulse Shaper Power Supply module against brownout when many discs            *
+ * are flipped back to back e.g. Delay(0) with All() on a full chain.               *
+ * -> flips_per_second - sustained number of flips per second, 0 - governor off     *
+ * -> burst - number of flips that can be released back to back before the          *
+ *    governor starts to space the current pulses, min 1                            *
+ * The call also resets the throttling counters.                                    *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::FlipRate(uint16_t flips_per_second, uint8_t burst /* = 1 */)
+{
+  if(burst == 0) burst = 1;
+  
+  flip_rate = flips_per_second;
+  flip_burst = burst;
+
+  // Start with a full bucket
+  if(flip_rate > 0) flip_credit = (1000000UL / flip_rate) * flip_burst;
+  flip_credit_time = clock_micros();
+  
+  throttle_count = 0;
+  throttle_time = 0;
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function returns how many flips had to wait for the flip-rate governor       *
+ *----------------------------------------------------------------------------------*/
+uint32_t FlipDisc::ThrottleCount(void)
+{
+  return throttle_count;
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function returns the total time in microseconds that flips                   *
+ * spent waiting for the flip-rate governor, also the flips held back               *
+ * by Service() until one of the next calls                                         *
+ *----------------------------------------------------------------------------------*/
+uint32_t FlipDisc::ThrottleTime(void)
+{
+  return throttle_time;
+}
+
+#if FLIPDISC_STATS
+/*----------------------------------------------------------------------------------*
+ * The function returns the performance counters of the library, e.g. to find       *
+ * which screens cost the most time or to validate optimizations on real hardware.  *
+ * See FlipStats in FlipDisc.h. The counters run since power up                     *
+ * or since the last ResetStats() call.                                             *
+ *----------------------------------------------------------------------------------*/
+FlipStats FlipDisc::GetStats(void)
+{
+  FlipStats current_stats = flip_stats;
+
+  current_stats.payload_bytes = spi_frame_bytes - flip_stats.padding_bytes;
+  current_stats.throttle_count = throttle_count;
+  current_stats.throttle_time = throttle_time;
+  current_stats.pulses_saved = pulses_saved;
+  
+  if(flip_stats.update_count > 0) current_stats.update_time_avg = update_time_total / flip_stats.update_count;
+  
+  return current_stats;
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function resets all performance counters, also the counters of               *
+ * the flip-rate governor and of the lookahead planner                              *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::ResetStats(void)
+{
+  memset(&flip_stats, 0, sizeof(flip_stats));
+  spi_frame_bytes = 0;
+  update_time_total = 0;
+  throttle_count = 0;
+  throttle_time = 0;
+  pulses_saved = 0;
+}
+#endif
+
+/*----------------------------------------------------------------------------------*
+ * The function selects the time source of the library. Call the function           *
+ * before Init(), the times saved by the library are not converted.                 *
+ * -> REAL_CLOCK - micros(), millis(), delay() and delayMicroseconds() (default)    *
+ * -> VIRTUAL_CLOCK - the time starts at 0 and advances only when the library       *
+ *    waits - the charging, the current pulse, the delay effect, the flip-rate      *
+ *    governor. The waits take no real time, so host simulations and benchmarks     *
+ *    of thousands of updates finish in milliseconds, while the statistics,         *
+ *    deadlines and OnFlip() times follow the simulated timeline. Use ClockMillis()  *
+ *    for Deadline() and ClockWait() to let the time pass between Service() calls.  *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::Clock(uint8_t clock_source)
+{
+  if(clock_source == VIRTUAL_CLOCK)
+  {
+    virtual_micros = 0;
+    virtual_millis = 0;
+    virtual_micros_rest = 0;
+    Clock(VirtualMicros, VirtualMillis, VirtualWait);
+  }
+  else Clock(RealMicros, RealMillis, RealWait);
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function sets a user time source, e.g. a simulation clock.                   *
+ * -> new_clock_micros - function returning the time in microseconds               *
+ * -> new_clock_millis - function returning the time in milliseconds               *
+ * -> new_clock_wait - function waiting for, or moving the clock forward by,        *
+ *    the given number of microseconds                                              *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::Clock(uint32_t (*new_clock_micros)(void), uint32_t (*new_clock_millis)(void), void (*new_clock_wait)(uint32_t wait_time))
+{
+  clock_micros = new_clock_micros;
+  clock_millis = new_clock_millis;
+  clock_wait = new_clock_wait;
+}
+
+/*----------------------------------------------------------------------------------*
+ * The functions return the time of the library clock - see Clock()                *
+ *----------------------------------------------------------------------------------*/
+uint32_t FlipDisc::ClockMicros(void)
+{
+  return clock_micros();
+}
+
+uint32_t FlipDisc::ClockMillis(void)
+{
+  return clock_millis();
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function waits using the library clock, the virtual clock is only moved      *
+ * forward, e.g. to simulate the time of the user code between Service() calls     *
+ * -> wait_time - time in microseconds                                              *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::ClockWait(uint32_t wait_time)
+{
+  clock_wait(wait_time);
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function enables the trace recorder - every edge of the EN, CH and PL        *
+ * pins and every SPI byte is saved with its time in a ring buffer in RAM, 4 bytes  *
+ * per record. When the buffer is full, the oldest records are overwritten, so      *
+ * the buffer always holds the last trace_records events. The trace shows         *
+ * the timing of the pulses in the field, e.g. latency outliers or mis-sequenced    *
+ * pulses, and is printed by TraceDump(). Saving a record takes a call of micros(), *
+ * so the traced SPI frames are a little slower. The previous trace is discarded.   *
+ * Returns 1 if the trace recorder is enabled.                                      *
+ * -> trace_records - size of the ring buffer in records, 0 - trace disabled        *
+ *    and the buffer released                                                       *
+ *----------------------------------------------------------------------------------*/
+bool FlipDisc::TraceBegin(uint16_t trace_records)
+{
+  free(traceArray);
+  traceArray = NULL;
+  trace_size = 0;
+  trace_next = 0;
+  trace_count = 0;
+  trace_lost = 0;
+
+  if(trace_records == 0) return 0;
+  
+  traceArray = (TraceRecord *)calloc(trace_records, sizeof(TraceRecord));
+  if(traceArray == NULL) return 0;
+  
+  trace_size = trace_records;
+  trace_time = clock_micros();
+  return 1;
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function prints the trace, one event per line from the oldest one:          *
+ * time in microseconds since the first printed event, signal (EN, CH, PL, SPI)     *
+ * and pin level or SPI byte in hex, e.g. "1130,PL,1" or "12,SPI,0x4A".             *
+ * Times of 65535 us or more between two events are printed as 65535.               *
+ * The first line gives the number of events and of the overwritten events.         *
+ * The trace is not cleared.                                                        *
+ * -> output - Serial or another Print object                                       *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::TraceDump(Print &output)
+{
+  if(traceArray == NULL) return;
+
+  output.print(F("trace "));
+  output.print(trace_count);
+  output.print(F(" lost "));
+  output.println(trace_lost);
+  
+  uint16_t trace_slot = (trace_next + trace_size - trace_count) % trace_size;
+  uint32_t trace_us = 0;
+  
+  for(uint16_t record_number = 0; record_number < trace_count; record_number++)
+  {
+    TraceRecord trace_record = traceArray[trace_slot];
+    trace_slot = (trace_slot + 1) % trace_size;
+    
+    if(record_number > 0) trace_us = trace_us + trace_record.time_delta;
+
+    output.print(trace_us);
+    
+    if(trace_record.signal == trace_en) output.print(F(",EN,"));
+    if(trace_record.signal == trace_ch) output.print(F(",CH,"));
+    if(trace_record.signal == trace_pl) output.print(F(",PL,"));
+    
+    if(trace_record.signal == trace_spi)
+    {
+      output.print(F(",SPI,0x"));
+      if(trace_record.data < 0x10) output.print('0');
+      output.println(trace_record.data, HEX);
+    }
+    else output.println(trace_record.data);
+  }
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function enables the wear counters - the number of flips of each disc        *
+ * of all displays, saved in the EEPROM (AVR) or in the EEPROM emulated in flash     *
+ * (ESP32, ESP8266). Call the function after Init(). The flips are counted in RAM   *
+ * (one byte per disc) and added to the counters in the EEPROM in batches, when     *
+ * one of the RAM counters has reached 192 flips: after the update in the DIRECT    *
+ * mode, by Flush(), or in idle time of Service() byte by byte within its max_us.   *
+ * WearSave() saves at once. Each batch is saved in the next slot, so the EEPROM    *
+ * wear is spread over all slots and an interrupted save never destroys the         *
+ * previous counters.                                                               *
+ * Returns 1 if the counters are enabled, 0 - no EEPROM or not enough RAM.          *
+ * -> eeprom_address - EEPROM address of the first slot                             *
+ * -> eeprom_slots - number of slots, each slot takes 5 + 4 x number of all discs   *
+ *    bytes, e.g. 4 x D7SEG - 97 bytes. At least 2 slots are recommended.           *
+ *----------------------------------------------------------------------------------*/
+bool FlipDisc::WearBegin(uint16_t eeprom_address, uint8_t eeprom_slots /* = 2 */)
+{
+#if defined(FLIPDISC_EEPROM)
+  if((wearDeltaArray != NULL) || (eeprom_slots == 0)) return (wearDeltaArray != NULL);
+
+  wear_discs = DiscIndex(8, 0);
+  if(wear_discs == 0) return 0;
+  
+  wearDeltaArray = (uint8_t *)calloc(wear_discs, 1);
+  if(wearDeltaArray == NULL) return 0;
+
+  wear_address = eeprom_address;
+  wear_slots = eeprom_slots;
+  wear_valid = false;
+
+  EepromBegin(WearSlotAddress(wear_slots));
+
+  // Look for the slot with the newest counters
+  for(int slot_number = 0; slot_number < wear_slots; slot_number++)
+  {
+    if(WearSlotValid(slot_number) == false) continue;
+    
+    uint16_t slot_sequence = EepromRead(WearSlotAddress(slot_number), 2);
+    
+    if((wear_valid == false) || ((int16_t)(slot_sequence - wear_sequence) > 0))
+    {
+      wear_slot = slot_number;
+      wear_sequence = slot_sequence;
+      wear_valid = true;
+    }
+  }
+
+  // No valid slot - the first save goes to slot 0
+  if(wear_valid == false) wear_slot = wear_slots - 1;
+  
+  return 1;
+#else
+  (void)eeprom_address;
+  (void)eeprom_slots;
+  return 0;
+#endif
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function adds the flips counted in RAM to the wear counters in the EEPROM.   *
+ * Call it e.g. before a planned power off to save the latest flips.                *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::WearSave(void)
+{
+#if defined(FLIPDISC_EEPROM)
+  if(wearDeltaArray == NULL) return;
+
+  // The save in progress has already taken the flips of some discs, so finish it first
+  if(wear_save_offset != 0) while(WearSaveStep(0xFFFFFFFF) == true);
+  
+  wear_save_needed = true;
+  while(WearSaveStep(0xFFFFFFFF) == true);
+#endif
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function does one step of the wear counters save - one EEPROM byte, so      *
+ * Service() can save the counters in its idle time without exceeding max_us.       *
+ * Returns 1 if the step has been done, 0 - no save is needed or the step does      *
+ * not fit in max_time microseconds.                                                *
+ *                                                                                  *
+ * Brief:                                                                           *
+ * The slot bytes are written in order: number of discs, counters, checksum and     *
+ * the sequence number last, with the commit. The flips of the disc are taken       *
+ * from RAM when its counter is written, the flips counted later are saved          *
+ * in the next batch.                                                               *
+ *----------------------------------------------------------------------------------*/
+bool FlipDisc::WearSaveStep(uint32_t max_time)
+{
+#if defined(FLIPDISC_EEPROM)
+  if(wearDeltaArray == NULL) return 0;
+  
+  if(wear_save_offset == 0)
+  {
+    if(wear_save_needed == false) return 0;
+
+    // The new batch starts after the sequence number
+    wear_save_needed = false;
+    wear_save_offset = 2;
+    wear_save_checksum = 0;
+  }
+
+  uint16_t slot_size = WearSlotSize();
+  uint32_t step_time = eeprom_write_time;
+  if(wear_save_offset == slot_size) step_time = 2 * eeprom_write_time + eeprom_commit_time;
+  if(step_time > max_time) return 0;
+
+  uint16_t new_address = WearSlotAddress((wear_slot + 1) % wear_slots);
+  uint8_t no_checksum = 0;
+  
+  if(wear_save_offset < 4)
+  {
+    EepromWrite(new_address + wear_save_offset, (wear_discs >> (8 * (wear_save_offset - 2))) & 0xFF, 1, wear_save_checksum);
+  }
+  else if(wear_save_offset < slot_size - 1)
+  {
+    uint16_t disc_index = (wear_save_offset - 4) / 4;
+    uint8_t byte_number = (wear_save_offset - 4) % 4;
+
+    if(byte_number == 0)
+    {
+      wear_save_counter = wearDeltaArray[disc_index];
+      if(wear_valid == true) wear_save_counter = wear_save_counter + EepromRead(WearSlotAddress(wear_slot) + 4 + 4 * disc_index, 4);
+      wearDeltaArray[disc_index] = 0;
+    }
+
+    EepromWrite(new_address + wear_save_offset, (wear_save_counter >> (8 * byte_number)) & 0xFF, 1, wear_save_checksum);
+  }
+  else if(wear_save_offset == slot_size - 1)
+  {
+    EepromWrite(new_address + wear_save_offset, wear_save_checksum, 1, no_checksum);
+  }
+  else
+  {
+    // The sequence number is written last - from now on the new slot is the newest one
+    wear_sequence = wear_sequence + 1;
+    EepromWrite(new_address, wear_sequence, 2, no_checksum);
+    EepromCommit();
+
+    wear_slot = (wear_slot + 1) % wear_slots;
+    wear_valid = true;
+    wear_save_offset = 0;
+    return 1;
+  }
+
+  wear_save_offset = wear_save_offset + 1;
+  return 1;
+#else
+  (void)max_time;
+  return 0;
+#endif
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function returns the number of flips of the selected disc since the wear     *
+ * counters were first enabled, e.g. to find the discs that will fail first.        *
+ * -> module_type - D7SEG, D3X1, ...                                                *
+ * -> module_number - relative number of the display                                *
+ * -> disc_number - the same disc number as in the Disc_...() function of           *
+ *    the display: 0-22 for D7SEG, from 1 for other displays                        *
+ *----------------------------------------------------------------------------------*/
+uint32_t FlipDisc::Wear(uint8_t module_type, uint8_t module_number, uint8_t disc_number)
+{
+#if defined(FLIPDISC_EEPROM)
+  if(wearDeltaArray == NULL) return 0;
+  
+  uint8_t module_position = ModulePosition(module_number, module_type);
+  if(module_position == 0xFF) return 0;
+
+  if(module_type != D7SEG) disc_number = disc_number - 1;
+  if(disc_number >= moduleInitArray[module_position][number_discs_column]) return 0;
+
+  uint16_t disc_index = DiscIndex(module_position, disc_number);
+  uint32_t wear_counter = wearDeltaArray[disc_index];
+  
+  if(wear_save_offset > 4 + 4 * disc_index)
+  {
+    // The flips of the disc have already been taken by the save in progress
+    if(wear_save_offset >= 8 + 4 * disc_index) wear_counter = wear_counter + EepromRead(WearSlotAddress((wear_slot + 1) % wear_slots) + 4 + 4 * disc_index, 4);
+    else wear_counter = wear_counter + wear_save_counter;
+  }
+  else if(wear_valid == true) wear_counter = wear_counter + EepromRead(WearSlotAddress(wear_slot) + 4 + 4 * disc_index, 4);
+  
+  return wear_counter;
+#else
+  (void)module_type;
+  (void)module_number;
+  (void)disc_number;
+  return 0;
+#endif
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function enables saving the state of all discs in the EEPROM (AVR) or        *
+ * in the EEPROM emulated in flash (ESP32, ESP8266). Call the function after        *
+ * Init(). With restore = 1 the saved state is restored as the known state of       *
+ * the discs, so after power up the first update flips only the discs that          *
+ * differ instead of a full redraw. The state is restored only if                   *
+ * it was saved for the same displays, its CRC is correct and no disc has been      *
+ * flipped since the save - the first flip after the save clears the marker of      *
+ * the saved state (one byte written and committed: in the DIRECT mode before       *
+ * the first pulse of the update, Service() does it within its max_us). A display   *
+ * which keeps changing, e.g. a clock, has a valid saved state only between a save  *
+ * and its next flip. The state is saved at most once per                           *
+ * save_interval: after the updates in the DIRECT mode, by Flush(), and in idle     *
+ * time of Service() byte by byte within its max_us (on ESP32/ESP8266 the final     *
+ * commit needs max_us of about 50ms). Step() does not save. StateSave() saves      *
+ * at once. Only the bytes that change are written, but the bytes of fast           *
+ * changing displays, e.g. seconds, are written at every save - mind the EEPROM     *
+ * endurance (about 100 000 writes) when choosing save_interval.                    *
+ * Returns 1 if the state has been restored.                                        *
+ * -> eeprom_address - EEPROM address of the state, 90 bytes                        *
+ * -> save_interval - minimum time between the saves in seconds, 0 - after every    *
+ *    update                                                                        *
+ * -> restore - 1 - restore the saved state, 0 - all discs unknown, the first       *
+ *    update is a full refresh                                                      *
+ *----------------------------------------------------------------------------------*/
+bool FlipDisc::StateBegin(uint16_t eeprom_address, uint16_t save_interval /* = 600 */, bool restore /* = 1 */)
+{
+#if defined(FLIPDISC_EEPROM)
+  state_address = eeprom_address;
+  state_interval = save_interval;
+  state_save_time = clock_millis();
+  state_enabled = true;
+  
+  EepromBegin(state_address + state_record_size);
+
+  // Without the valid marker the record is stale - the discs were flipped after the save
+  state_saved = (EEPROM.read(state_address) == state_valid);
+  if((restore == false) || (state_saved == false)) return 0;
+  
+  // The record interrupted by a power failure during the save is not restored
+  uint8_t crc = 0;
+  for(int byte_number = 0; byte_number < state_record_size - 2; byte_number++) crc = StateCrc(crc, EEPROM.read(state_address + 1 + byte_number));
+  if(crc != EEPROM.read(state_address + state_record_size - 1)) return 0;
+  
+  // The state saved for other displays is not restored
+  for(int module_position = 0; module_position < 8; module_position++)
+  {
+    if(EEPROM.read(state_address + 1 + module_position) != moduleInitArray[module_position][module_type_column]) return 0;
+  }
+
+  for(int module_position = 0; module_position < 8; module_position++)
+  {
+    for(int byte_number = 0; byte_number < 5; byte_number++)
+    {
+      uint8_t state_byte = EEPROM.read(state_address + 1 + 8 + 5 * module_position + byte_number);
+      uint8_t known_byte = EEPROM.read(state_address + 1 + 48 + 5 * module_position + byte_number);
+
+      discStateArray[module_position][byte_number] = state_byte & known_byte;
+      discKnownArray[module_position][byte_number] = known_byte;
+    }
+  }
+
+  state_dirty = false;
+  return 1;
+#else
+  (void)eeprom_address;
+  (void)save_interval;
+  (void)restore;
+  return 0;
+#endif
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function saves the state of all discs in the EEPROM now, e.g. before         *
+ * a planned power off.                                                             *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::StateSave(void)
+{
+#if defined(FLIPDISC_EEPROM)
+  if(state_enabled == false) return;
+
+  // The whole record from the beginning, without waiting for the save interval
+  state_save_byte = 0;
+  while(StateSaveStep(0xFFFFFFFF) == true);
+#endif
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function saves the state of the discs if a disc has been flipped since       *
+ * the last save and the save interval has elapsed. The whole record is written     *
+ * at once - used after the updates of the DIRECT mode and by Flush().              *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::StateAutoSave(void)
+{
+#if defined(FLIPDISC_EEPROM)
+  while(StateSaveStep(0xFFFFFFFF) == true);
+#endif
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function does one step of the state save - at most one EEPROM byte, so       *
+ * Service() can save the state in its idle time without exceeding max_us.         *
+ * Returns 1 if the step has been done, 0 - no save is due or the step does not     *
+ * fit in max_time microseconds.                                                    *
+ *                                                                                  *
+ * Brief:                                                                           *
+ * Step 0 clears the marker, steps 1-88 write the module types and the disc arrays, *
+ * step 89 the CRC and step 90 sets the marker and commits the record. A disc       *
+ * changed during the save starts the save again from step 0 - see StateChanged().  *
+ *----------------------------------------------------------------------------------*/
+bool FlipDisc::StateSaveStep(uint32_t max_time)
+{
+#if defined(FLIPDISC_EEPROM)
+  if(state_enabled == false) return 0;
+  
+  if(state_save_byte == 0xFF)
+  {
+    // A new save starts only if a disc has been flipped and the save interval has elapsed
+    if(state_dirty == false) return 0;
+    if(clock_millis() - state_save_time < (uint32_t)state_interval * 1000) return 0;
+    state_save_byte = 0;
+  }
+
+  uint32_t step_time = eeprom_write_time;
+  if(state_save_byte == state_record_size) step_time = step_time + eeprom_commit_time;
+  if(step_time > max_time) return 0;
+
+  uint8_t no_checksum = 0;
+  
+  if(state_save_byte == 0)
+  {
+    // The record is invalid while it is being written
+    EepromWrite(state_address, 0, 1, no_checksum);
+    state_saved = false;
+    state_save_crc = 0;
+  }
+  else if(state_save_byte < state_record_size - 1)
+  {
+    uint8_t data_byte = StateByte(state_save_byte - 1);
+    EepromWrite(state_address + state_save_byte, data_byte, 1, no_checksum);
+    state_save_crc = StateCrc(state_save_crc, data_byte);
+  }
+  else if(state_save_byte == state_record_size - 1)
+  {
+    EepromWrite(state_address + state_save_byte, state_save_crc, 1, no_checksum);
+  }
+  else
+  {
+    // The marker is written last - from now on the record is valid
+    EepromWrite(state_address, state_valid, 1, no_checksum);
+    EepromCommit();
+
+    state_save_byte = 0xFF;
+    state_save_time = clock_millis();
+    state_dirty = false;
+    state_saved = true;
+    return 1;
+  }
+
+  state_save_byte = state_save_byte + 1;
+  return 1;
+#else
+  (void)max_time;
+  return 0;
+#endif
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function clears the marker of the saved state before the first pulse which   *
+ * changes a disc after the save, so the stale state is never restored after        *
+ * a power failure. One byte is written once per save.                              *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::StateInvalidate(uint8_t module_position, uint8_t disc_number, bool disc_status)
+{
+#if defined(FLIPDISC_EEPROM)
+  if((state_enabled == false) || (state_saved == false) || (module_position == 0xFF)) return;
+
+  // The pulse into a disc already showing the status does not change the saved state
+  if((ReadDiscBit(discKnownArray, module_position, disc_number) == 1) && 
+     (ReadDiscBit(discStateArray, module_position, disc_number) == disc_status)) return;
+
+  StateClear();
+#else
+  (void)module_position;
+  (void)disc_number;
+  (void)disc_status;
+#endif
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function marks the status of the disc as unknown. In the QUEUE mode         *
+ * a disc with known status is queued to be flipped again to its last status,       *
+ * unless a new status is already waiting in the queue.                             *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::UnknownDisc(uint8_t module_position, uint8_t disc_number)
+{
+  if(ReadDiscBit(discKnownArray, module_position, disc_number) == 0) return;
+
+  WriteDiscBit(discKnownArray, module_position, disc_number, 0);
+  
+#if defined(FLIPDISC_EEPROM)
+  StateChanged();
+#endif
+
+  if(update_mode == DIRECT) return;
+  if(ReadDiscBit(discPendingArray, module_position, disc_number) == 1) return;
+
+  QueueDisc(module_position, disc_number, ReadDiscBit(discStateArray, module_position, disc_number));
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function counts the flip of the disc in the RAM wear counter - only when     *
+ * the disc has turned over, not the repeated pulses of the DIRECT mode, the        *
+ * refresh sweep or Unknown(). A counter close to full requests saving the counters.*
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::WearCount(uint8_t module_position, uint8_t disc_number)
+{
+#if defined(FLIPDISC_EEPROM)
+  if(wearDeltaArray == NULL) return;
+
+  uint16_t disc_index = DiscIndex(module_position, disc_number);
+  
+  if(wearDeltaArray[disc_index] < 255) wearDeltaArray[disc_index] = wearDeltaArray[disc_index] + 1;
+  if(wearDeltaArray[disc_index] >= 192) wear_save_needed = true;
+#else
+  (void)module_position;
+  (void)disc_number;
+#endif
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The functions measure the update time - from the first disc saved in the queue   *
+ * (QUEUE mode) or the first current pulse (DIRECT mode) until the queue is empty   *
+ * or the display function has finished.                                            *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::UpdateStart(void)
+{
+  if(update_started == true) return;
+
+#if FLIPDISC_STATS
+  update_start = clock_micros();
+#endif
+  update_started = true;
+}
+
+void FlipDisc::UpdateEnd(void)
+{
+  if(update_started == false) return;
+
+  update_started = false;
+  
+#if FLIPDISC_STATS
+  uint32_t update_time = clock_micros() - update_start;
+  flip_stats.update_count = flip_stats.update_count + 1;
+  update_time_total = update_time_total + update_time;
+  if(update_time > flip_stats.update_time_max) flip_stats.update_time_max = update_time;
+#endif
+
+  // The QUEUE mode saves in idle time of Service() within its time limit, or in Flush()
+  if(update_mode == DIRECT) EepromSave();
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function saves the wear counters and the state of the discs, if needed,      *
+ * at once - between the updates, never in the middle of one.                       *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::EepromSave(void)
+{
+#if defined(FLIPDISC_EEPROM)
+  if(wear_save_needed == true) WearSave();
+#endif
+  StateAutoSave();
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function refills the flip-rate governor bucket and returns the time          *
+ * in microseconds we still have to wait before the next flip can be released.      *
+ * 0 - the flip can be released now.                                                *
+ *----------------------------------------------------------------------------------*/
+uint32_t FlipDisc::FlipRateWait(void)
+{
+  if(flip_rate == 0) return 0;
+
+  uint32_t flip_cost = 1000000UL / flip_rate;
+  uint32_t flip_credit_max = flip_cost * flip_burst;
+  uint32_t time_current = clock_micros();
+
+  uint32_t time_elapsed = time_current - flip_credit_time;
+  flip_credit_time = time_current;
+
+  // After a long idle time the bucket is simply full, the sum must not overflow
+  if(time_elapsed > flip_credit_max) time_elapsed = flip_credit_max;
+  
+  flip_credit = flip_credit + time_elapsed;
+  if(flip_credit > flip_credit_max) flip_credit = flip_credit_max;
+
+  if(flip_credit >= flip_cost) return 0;
+  else return flip_cost - flip_credit;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function waits until the flip-rate governor releases the next flip           *
+ * and takes the cost of one flip from the bucket.                                  *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::FlipRateTake(void)
+{
+  if(flip_rate == 0) return;
+
+  uint32_t wait_start = clock_micros();
+  uint32_t held_time = 0;
+
+  // The flip held back by Service() waited for the governor between the calls,
+  // but not longer than the governor delay at the time it was held back
+  if(flip_held == true)
+  {
+    held_time = wait_start - flip_held_time;
+    if(held_time > flip_held_wait) held_time = flip_held_wait;
+  }
+  
+  if(FlipRateWait() > 0)
+  {
+    if(flip_held == false) throttle_count = throttle_count + 1;
+    
+    while(FlipRateWait() > 0)
+    {
+      // Wait, the virtual clock moves to the release of the next flip
+      ClockIdle(FlipRateWait());
+    }
+
+    held_time = held_time + (clock_micros() - wait_start);
+  }
+
+  throttle_time = throttle_time + held_time;
+
+  flip_credit = flip_credit - (1000000UL / flip_rate);
+  flip_held = false;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function returns the absolute position 0-7 of the display in the series      *
+ * of all displays based on its relative number (module_number) and its type        *
+ * (module_type). 0xFF - the display has not been declared in Init().               *
+ *----------------------------------------------------------------------------------*/
+uint8_t FlipDisc::ModulePosition(uint8_t module_number, uint8_t module_type)
+{
+  for(int module_position = 0; module_position < 8; module_position++)
+  {
+    if((moduleInitArray[module_position][module_type_column] == module_type) && 
+       (moduleInitArray[module_position][module_relative_position_column] == module_number)) return module_position;
+  }
+
+  return 0xFF;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * In the QUEUE mode the function saves the new status of the selected disc         *
+ * in the queue of pending flips and returns 1 - the disc must not be flipped now.  *
+ * While the queue is being flushed the function returns 0. In the DIRECT mode      *
+ * it returns 1 if the disc already shows the new status (see FlipNeeded()),        *
+ * otherwise 0.                                                                     *
+ * -> disc_number - disc number 0-35 counting from 0 for all display types          *
+ *                                                                                  *
+ * Brief:                                                                           *
+ * The queue is keyed by module and disc. If the disc is already waiting in         *
+ * the queue, the new status replaces the pending one (the latest status wins).     *
+ * If the disc already shows the new status, the pending flip is cancelled.         *
+ *----------------------------------------------------------------------------------*/
+bool FlipDisc::Queue(uint8_t module_type, uint8_t module_number, uint8_t disc_number, bool disc_status)
+{
+  // With the driver task running, the calls from other tasks are passed to the driver task
+  if(DriverInput() == true)
+  {
+    uint8_t module_position = ModulePosition(module_number, module_type);
+    if(module_position != 0xFF) DriverPush(module_position, disc_number, disc_status);
+    return 1;
+  }
+  
+  uint8_t module_position = ModulePosition(module_number, module_type);
+  
+  if(queue_input == false)
+  {
+    // The queue is being flushed (known discs already cancelled) or the pulse is forced
+    if((update_mode == QUEUE) || (flip_forced == true) || (module_position == 0xFF)) return 0;
+    
+    // DIRECT mode - the disc which already shows the new status is not pulsed again
+    if(FlipNeeded(module_position, disc_number, disc_status) == true) return 0;
+#if FLIPDISC_STATS
+    flip_stats.pulses_skipped = flip_stats.pulses_skipped + 1;
+#endif
+    return 1;
+  }
+  
+  if(module_position == 0xFF) return 1;
+
+  QueueInput(module_position, disc_number, disc_status);
+  return 1;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function saves the new status of the disc in the frame being written         *
+ * if the frame rate is limited, otherwise in the queue of pending flips.           *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::QueueInput(uint8_t module_position, uint8_t disc_number, bool disc_status)
+{
+  if(frame_interval > 0)
+  {
+    // With the frame rate limit the new disc status is saved in the frame being written
+    uint8_t frame_last = (frame_first + frame_count) % frame_buffer_size;
+    WriteDiscBit(frameTargetArray[frame_last], module_position, disc_number, disc_status);
+    WriteDiscBit(frameMaskArray[frame_last], module_position, disc_number, 1);
+    return;
+  }
+
+  QueueDisc(module_position, disc_number, disc_status);
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function saves the new status of the disc in the queue of pending flips.     *
+ * If the disc is already waiting in the queue, the new status replaces the         *
+ * pending one. If the disc already shows the new status, the flip is cancelled.    *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::QueueDisc(uint8_t module_position, uint8_t disc_number, bool disc_status)
+{
+  if((ReadDiscBit(discKnownArray, module_position, disc_number) == 1) &&
+     (ReadDiscBit(discStateArray, module_position, disc_number) == disc_status))
+  {
+    // The disc already shows the new status - cancel the pending flip
+    WriteDiscBit(discPendingArray, module_position, disc_number, 0);
+#if FLIPDISC_STATS
+    flip_stats.pulses_skipped = flip_stats.pulses_skipped + 1;
+#endif
+  }
+  else
+  {
+    WriteDiscBit(discTargetArray, module_position, disc_number, disc_status);
+    WriteDiscBit(discPendingArray, module_position, disc_number, 1);
+    frame_flipping = true;
+    UpdateStart();
+  }
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function moves the oldest complete frame to the queue of pending flips       *
+ * if the time since the previous frame is at least frame_interval, or all          *
+ * complete frames when forced by Flush(). The pending flips of the previous frame  *
+ * are retargeted to the new frame.                                                 *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::FrameToQueue(bool frame_force)
+{
+  if(frame_count == 0) return;
+  if((frame_force == false) && (clock_millis() - frame_time < frame_interval)) return;
+
+  while(frame_count > 0)
+  {
+    for(int module_position = 0; module_position < 8; module_position++)
+    {
+      for(int disc_number = 0; disc_number < moduleInitArray[module_position][number_discs_column]; disc_number++)
+      {
+        if(ReadDiscBit(frameMaskArray[frame_first], module_position, disc_number) == 1)
+        {
+          // The disc is always pending somewhere for the FlipTask of an application task
+          DriverLock();
+          bool disc_status = ReadDiscBit(frameTargetArray[frame_first], module_position, disc_number);
+          if(FlipReverted(module_position, disc_number, disc_status) == false) QueueDisc(module_position, disc_number, disc_status);
+          WriteDiscBit(frameMaskArray[frame_first], module_position, disc_number, 0);
+          DriverUnlock();
+        }
+      }
+    }
+
+    frame_first = (frame_first + 1) % frame_buffer_size;
+    frame_count = frame_count - 1;
+
+    if(frame_force == false) break;
+  }
+
+  frame_time = clock_millis();
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * Lookahead planner - the function checks whether the flip of the disc from        *
+ * the oldest frame would be reverted by one of the next waiting frames sooner      *
+ * than lookahead_hold ms. If so, the flip and the flip back are skipped.           *
+ * Discs with unknown status are always flipped.                                    *
+ *----------------------------------------------------------------------------------*/
+bool FlipDisc::FlipReverted(uint8_t module_position, uint8_t disc_number, bool disc_status)
+{
+  if(lookahead_hold == 0) return 0;
+  if(ReadDiscBit(discKnownArray, module_position, disc_number) == 0) return 0;
+
+  // The status the disc will show without this frame
+  bool current_status = ReadDiscBit(discStateArray, module_position, disc_number);
+  if(ReadDiscBit(discPendingArray, module_position, disc_number) == 1) 
+    current_status = ReadDiscBit(discTargetArray, module_position, disc_number);
+  
+  if(current_status == disc_status) return 0;
+
+  for(uint8_t frame_offset = 1; frame_offset < frame_count; frame_offset++)
+  {
+    if((uint32_t)frame_offset * frame_interval >= lookahead_hold) return 0;
+    
+    uint8_t frame_slot = (frame_first + frame_offset) % frame_buffer_size;
+    if((ReadDiscBit(frameMaskArray[frame_slot], module_position, disc_number) == 1) &&
+       (ReadDiscBit(frameTargetArray[frame_slot], module_position, disc_number) == current_status))
+    {
+      pulses_saved = pulses_saved + 2;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function returns 1 if the frame with a deadline should not start yet.        *
+ * The update starts at the deadline minus the estimated duration of all            *
+ * pending flips. Once the first disc is flipped the frame is never stopped.        *
+ *----------------------------------------------------------------------------------*/
+bool FlipDisc::DeadlineWait(void)
+{
+  if((frame_deadline_set == false) || (frame_started == true)) return 0;
+  if(Pending() == 0) return 0;
+
+  // Time of one current pulse, the flip-rate governor can make the pulses slower
+  uint32_t pulse_time = PulseTime();
+  if((flip_rate > 0) && (pulse_time < 1000000UL / flip_rate)) pulse_time = 1000000UL / flip_rate;
+
+ /*
+  * Estimated duration of the update. The current pulses are released one by one, 
+  * but the delay effects of different modules run in parallel, so the update takes 
+  * the longer of: all pulses back to back, or the slowest module with the delay effect 
+  * after each of its flips. The last flip of the module lands before its delay effect.
+  */
+  uint32_t update_time = Pending() * pulse_time;
+
+  for(int module_position = 0; module_position < 8; module_position++)
+  {
+    uint32_t module_flips = 0;
+
+    for(int disc_number = 0; disc_number < moduleInitArray[module_position][number_discs_column]; disc_number++)
+    {
+      module_flips = module_flips + ReadDiscBit(discPendingArray, module_position, disc_number);
+    }
+
+    if(module_flips == 0) continue;
+
+    uint32_t module_time = module_flips * pulse_time + (module_flips - 1) * ModuleDelay(module_position);
+    if(module_time > update_time) update_time = module_time;
+  }
+
+  // Estimated duration in ms
+  update_time = (update_time + 999) / 1000;
+  
+  if((int32_t)(clock_millis() - (frame_deadline - update_time)) < 0) return 1;
+
+  frame_started = true;
+  return 0;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function returns the estimated time of one flip in microseconds:             *
+ * charging time + current pulse + data frame + delay effect between flip discs.    *
+ * The flip-rate governor can make the flips even slower.                           *
+ * -> module_position - the delay effect of the display 0-7, 0xFF - flip_delay      *
+ *----------------------------------------------------------------------------------*/
+uint32_t FlipDisc::FlipTime(uint8_t module_position /* = 0xFF */)
+{
+  // 100us charging + 1ms current pulse + data frame and clearing outputs, about 3us per byte
+  uint32_t flip_time = 100 + 1000 + 6 * (uint32_t)number_all_bytes;
+  
+  flip_time = flip_time + ModuleDelay(module_position);
+
+  if((flip_rate > 0) && (flip_time < 1000000UL / flip_rate)) flip_time = 1000000UL / flip_rate;
+  
+  return flip_time;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function returns the estimated time of one flip in microseconds without      *
+ * the delay effect, which in the QUEUE mode is not waited for, and without         *
+ * the flip-rate governor - Service() adds the governor wait, FlipRateWait().       *
+ *----------------------------------------------------------------------------------*/
+uint32_t FlipDisc::PulseTime(void)
+{
+  return 100 + 1000 + 6 * (uint32_t)number_all_bytes;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function returns 1 if the selected disc has to be flipped to show            *
+ * the new status - in the DIRECT and in the QUEUE mode only discs with unknown     *
+ * or different status are flipped. Test() and the refresh sweep pulse the discs    *
+ * anyway, Unknown() forces the next flip of the selected discs.                    *
+ *----------------------------------------------------------------------------------*/
+bool FlipDisc::FlipNeeded(uint8_t module_position, uint8_t disc_number, bool disc_status)
+{
+  if(ReadDiscBit(discKnownArray, module_position, disc_number) == 0) return 1;
+  
+  return ReadDiscBit(discStateArray, module_position, disc_number) != disc_status;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function searches the queue of pending flips for the next disc to flip.      *
+ * The queue is searched from the beginning every time, so the discs saved in       *
+ * the queue while an update is in progress are never skipped.                      *
+ * Returns 0 - the queue is empty or all displays with pending flips wait           *
+ * for their delay effect.                                                          *
+ *----------------------------------------------------------------------------------*/
+bool FlipDisc::NextQueuedDisc(uint8_t &module_position, uint8_t &disc_number)
+{
+  uint8_t next_module_position = 0xFF;
+  
+ /*
+  * Look for the display with the highest priority among the displays with pending flips.
+  * Displays with the same priority are handled in the order of the series.
+  */
+  for(module_position = 0; module_position < 8; module_position++)
+  {
+    // Skip quickly the modules without pending flips
+    if((discPendingArray[module_position][0] | discPendingArray[module_position][1] | discPendingArray[module_position][2] |
+        discPendingArray[module_position][3] | discPendingArray[module_position][4]) == 0) continue;
+
+    // Skip the modules waiting for their delay effect, other modules are flipped in the meantime
+    if(FlipGapWait(module_position) > 0) continue;
+
+    if((next_module_position == 0xFF) || 
+       (moduleInitArray[module_position][module_priority_column] > moduleInitArray[next_module_position][module_priority_column]))
+    {
+      next_module_position = module_position;
+    }
+  }
+
+  if(next_module_position == 0xFF) return 0;
+  module_position = next_module_position;
+  
+  for(disc_number = 0; disc_number < moduleInitArray[module_position][number_discs_column]; disc_number++)
+  {
+    if(ReadDiscBit(discPendingArray, module_position, disc_number) == 1) return 1;
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function takes the next disc from the queue of pending flips and flips it.   *
+ * Returns 0 - the queue is empty or all displays with pending flips wait           *
+ * for their delay effect.                                                          *
+ *----------------------------------------------------------------------------------*/
+bool FlipDisc::FlipNextQueuedDisc(void)
+{
+  uint8_t module_position = 0;
+  uint8_t disc_number = 0;
+
+  if(NextQueuedDisc(module_position, disc_number) == false) return 0;
+
+  // The disc taken from the queue must be flipped immediately
+  queue_input = false;
+  
+  DriverLock();
+  WriteDiscBit(discPendingArray, module_position, disc_number, 0);
+  DriverUnlock();
+  FlipQueuedDisc(module_position, disc_number, ReadDiscBit(discTargetArray, module_position, disc_number));
+  
+  queue_input = (update_mode == QUEUE);
+
+  TaskDone();
+
+  if(Pending() == 0)
+  {
+    // The last flip of the frame with a deadline - save how much the deadline was missed
+    if(frame_deadline_set == true)
+    {
+      deadline_miss = (int32_t)(last_flip_time - frame_deadline);
+      frame_deadline_set = false;
+    }
+
+    QueueEmpty();
+  }
+
+  return 1;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function re-pulses the next disc of the integrity refresh sweep to its       *
+ * saved status, if the refresh interval has elapsed. Only the discs with known     *
+ * status are refreshed. The pulse is skipped if the display waits for its delay    *
+ * effect or the flip-rate governor holds the flip - the sweep never waits.         *
+ * Returns 1 if a disc has been re-pulsed.                                          *
+ *----------------------------------------------------------------------------------*/
+bool FlipDisc::RefreshNextDisc(void)
+{
+  if(refresh_interval == 0) return 0;
+  if(frame_count > 0) return 0;
+  if(clock_millis() - refresh_time < refresh_interval) return 0;
+  if(FlipRateWait() > 0) return 0;
+
+  // Look for the next disc with known status, at most one full sweep of all displays
+  // (36 discs and one step to the next display for each of the eight displays)
+  for(int disc_counter = 0; disc_counter < 8 * 37; disc_counter++)
+  {
+    if(refresh_disc >= moduleInitArray[refresh_position][number_discs_column])
+    {
+      refresh_disc = 0;
+      refresh_position = (refresh_position + 1) % 8;
+      continue;
+    }
+
+    uint8_t module_position = refresh_position;
+    uint8_t disc_number = refresh_disc;
+    
+    if(ReadDiscBit(discKnownArray, module_position, disc_number) == 0)
+    {
+      refresh_disc = refresh_disc + 1;
+      continue;
+    }
+
+    if(FlipGapWait(module_position) > 0) return 0;
+
+    refresh_disc = refresh_disc + 1;
+    refresh_time = clock_millis();
+
+    // The disc is pulsed immediately to the status it already shows, not saved in the queue
+    queue_input = false;
+    flip_forced = true;
+    FlipQueuedDisc(module_position, disc_number, ReadDiscBit(discStateArray, module_position, disc_number));
+    flip_forced = false;
+    queue_input = (update_mode == QUEUE);
+    
+    return 1;
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function calls the user callbacks after the last pending disc has been       *
+ * flipped - the end of the frame and the end of all queued work.                   *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::QueueEmpty(void)
+{
+  UpdateEnd();
+  
+  if(frame_flipping == true)
+  {
+    frame_flipping = false;
+    if(frame_callback != NULL) frame_callback();
+  }
+
+  // The next complete frame waiting in the frame buffer is not the end of the work
+  if((frame_count == 0) && (empty_callback != NULL)) empty_callback();
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function returns 1 if the driver task is running and the function has been  *
+ * called from another task - the disc command must be passed to the driver task.   *
+ *----------------------------------------------------------------------------------*/
+bool FlipDisc::DriverInput(void)
+{
+#if defined(ARDUINO_ARCH_ESP32)
+  if(driver_task == NULL) return 0;
+  return (xTaskGetCurrentTaskHandle() != driver_task);
+#else
+  return 0;
+#endif
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function passes the disc command to the driver task. Any number of tasks     *
+ * can call the function at the same time - the slot is reserved with              *
+ * compare-and-swap of the producer index. If the queue is full, the calling task   *
+ * waits for the driver task.                                                       *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::DriverPush(uint8_t module_position, uint8_t disc_number, bool disc_status)
+{
+#if defined(ARDUINO_ARCH_ESP32)
+  uint32_t slot_index = __atomic_load_n(&driver_tail, __ATOMIC_RELAXED);
+  DriverCommand *driver_command;
+
+  for(;;)
+  {
+    driver_command = &driverQueueArray[slot_index & (driver_queue_size - 1)];
+    uint32_t slot_sequence = __atomic_load_n(&driver_command->sequence, __ATOMIC_ACQUIRE);
+    int32_t slot_difference = (int32_t)(slot_sequence - slot_index);
+
+    if(slot_difference == 0)
+    {
+      // The slot is free - try to reserve it, on failure slot_index is reloaded
+      if(__atomic_compare_exchange_n(&driver_tail, &slot_index, slot_index + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+    }
+    else if(slot_difference < 0)
+    {
+      // The queue is full - wait for the driver task
+      vTaskDelay(1);
+      slot_index = __atomic_load_n(&driver_tail, __ATOMIC_RELAXED);
+    }
+    else slot_index = __atomic_load_n(&driver_tail, __ATOMIC_RELAXED);
+  }
+
+  driver_command->module_position = module_position;
+  driver_command->disc_number = disc_number;
+  driver_command->disc_status = disc_status;
+  
+  if(disc_number != 0xFF) __atomic_add_fetch(&driverCountArray[module_position], 1, __ATOMIC_RELEASE);
+  
+  // Publish the command to the driver task
+  __atomic_store_n(&driver_command->sequence, slot_index + 1, __ATOMIC_RELEASE);
+#else
+  (void)module_position;
+  (void)disc_number;
+  (void)disc_status;
+#endif
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function takes all commands from the driver queue and saves them            *
+ * in the frame buffer or in the queue of pending flips. Called only by             *
+ * the driver task.                                                                 *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::DriverPull(void)
+{
+#if defined(ARDUINO_ARCH_ESP32)
+  for(;;)
+  {
+    DriverCommand *driver_command = &driverQueueArray[driver_head & (driver_queue_size - 1)];
+    uint32_t slot_sequence = __atomic_load_n(&driver_command->sequence, __ATOMIC_ACQUIRE);
+    
+    // The next command has not been published yet
+    if((int32_t)(slot_sequence - (driver_head + 1)) < 0) break;
+
+    if(driver_command->disc_number == 0xFF) Frame();
+    else
+    {
+      // The disc moves from the driver queue to the frame buffer or the queue of pending flips
+      DriverLock();
+      QueueInput(driver_command->module_position, driver_command->disc_number, driver_command->disc_status);
+      __atomic_sub_fetch(&driverCountArray[driver_command->module_position], 1, __ATOMIC_RELEASE);
+      DriverUnlock();
+    }
+
+    // Free the slot for the producers
+    __atomic_store_n(&driver_command->sequence, driver_head + driver_queue_size, __ATOMIC_RELEASE);
+    driver_head = driver_head + 1;
+  }
+#endif
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function calls the completion callbacks of the modules with no discs         *
+ * waiting in the queue of pending flips or in the frame buffer.                    *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::TaskDone(void)
+{
+  for(int module_position = 0; module_position < 8; module_position++)
+  {
+    void (*task_callback)(void) = NULL;
+
+    // The callback is called once, clear it before the call so it can register a new one
+    DriverLock();
+    if((taskCallbackArray[module_position] != NULL) && (ModulePending(module_position) == 0))
+    {
+      task_callback = taskCallbackArray[module_position];
+      taskCallbackArray[module_position] = NULL;
+    }
+    DriverUnlock();
+
+    if(task_callback != NULL) task_callback();
+  }
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function flips one disc taken from the queue of pending flips.               *
+ * Based on the absolute position of the display in the series, the function        *
+ * calls the disc function of the corresponding display type.                       *
+ * -> module_position - absolute position of the display 0-7                        *
+ * -> disc_number - disc number 0-35 counting from 0 for all display types          *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::FlipQueuedDisc(uint8_t module_position, uint8_t disc_number, bool disc_status)
+{
+  uint8_t module_number = moduleInitArray[module_position][module_relative_position_column];
+  
+  switch (moduleInitArray[module_position][module_type_column]) 
+  {
+    case D7SEG:
+      Disc_7Seg(module_number, disc_number, disc_status);
+      break;
+
+    case D2X1:
+      Disc_2x1(module_number, disc_number + 1, disc_status);
+      break;
+
+    case D3X1:
+      Disc_3x1(module_number, disc_number + 1, disc_status);
+      break;
+
+    case D1X3:
+      Disc_1x3(module_number, disc_number + 1, disc_status);
+      break;
+
+    case D1X7:
+      Disc_1x7(module_number, disc_number + 1, disc_status);
+      break;
+
+    case D2X6:
+      Disc_2x6(module_number, disc_number + 1, disc_status);
+      break;
+
+    case D3X3:
+      Disc_3x3(module_number, disc_number + 1, disc_status);
+      break;
+
+    case D3X4:
+      Disc_3x4(module_number, disc_number + 1, disc_status);
+      break;
+
+    case D3X5:
+      Disc_3x5(module_number, disc_number + 1, disc_status);
+      break;
+
+    case D4X3X3:
+      Disc_4x3x3(module_number, disc_number + 1, disc_status);
+      break;
+
+    default:
+      break;
+  }
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function is used to check whether the number (module_number) of the selected *
+ * display (module_type) exists.                                                    *
+ * For example, if the display no.3 (module_number) of a specific type (module_type)*
+ * was selected and earlier in the Init() function we declared fewer or no displays *
+ * of the selected type (module_type), the function returns 1 - the fuse has tripped*
+ *----------------------------------------------------------------------------------*/
+bool FlipDisc::Fuse(uint8_t module_number, uint8_t module_type)
+{
+  uint8_t highest_module_number = 0;
+  
+  for(int i = 0; i < 8; i++)
+  {
+    if(moduleInitArray[i][module_type_column] == module_type) highest_module_number = highest_module_number + 1;
+  }
+  
+  if((module_number == 0) || (highest_module_number < module_number)) return 1;
+  else return 0;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * Simple protection from user error - returns 1 if the display has not been        *
+ * declared in Init() or the display has no such disc.                              *
+ * -> disc_number - the same disc number as in the Disc_...() function of           *
+ *    the display: 0-22 for D7SEG, from 1 for other displays                        *
+ *----------------------------------------------------------------------------------*/
+bool FlipDisc::DiscFuse(uint8_t module_number, uint8_t module_type, uint8_t disc_number)
+{
+  uint8_t module_position = ModulePosition(module_number, module_type);
+  if(module_position == 0xFF) return 1;
+  
+  if(module_type != D7SEG) disc_number = disc_number - 1;
+  
+  if(disc_number >= moduleInitArray[module_position][number_discs_column]) return 1;
+  else return 0;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function is used to wait between flip discs                                  *
+ * In the DIRECT mode the function waits for the end of the delay effect.           *
+ * In the QUEUE mode the delay effect is only scheduled - the next queued flip      *
+ * of the display waits for it, the discs of the other displays are flipped and     *
+ * Step() and Service() return to the user code in the meantime.                    *
+ * -> module_position - absolute position of the display 0-7                        *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::FlipDelay(uint8_t module_position)
+{
+  if(module_position >= 8) return;
+  
+  moduleGapStartArray[module_position] = clock_micros();
+  moduleGapArray[module_position] = ModuleDelay(module_position);
+#if FLIPDISC_STATS
+  flip_stats.delay_time = flip_stats.delay_time + moduleGapArray[module_position];
+#endif
+
+  if(update_mode == QUEUE) return;
+  
+  while(FlipGapWait(module_position) > 0)
+  {
+    // Wait, the virtual clock moves to the end of the delay effect
+    ClockIdle(FlipGapWait(module_position));
+  }  
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function returns the time in microseconds until one of the displays          *
+ * with pending flips ends its delay effect, 0 - a disc can be flipped now.         *
+ *----------------------------------------------------------------------------------*/
+uint32_t FlipDisc::QueueGapWait(void)
+{
+  uint32_t gap_wait = 0xFFFFFFFF;
+  
+  for(int module_position = 0; module_position < 8; module_position++)
+  {
+    if((discPendingArray[module_position][0] | discPendingArray[module_position][1] | discPendingArray[module_position][2] |
+        discPendingArray[module_position][3] | discPendingArray[module_position][4]) == 0) continue;
+
+    uint32_t module_wait = FlipGapWait(module_position);
+    if(module_wait < gap_wait) gap_wait = module_wait;
+  }
+
+  if(gap_wait == 0xFFFFFFFF) return 0;
+  return gap_wait;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function returns the time in microseconds until the end of the delay        *
+ * effect of the last flip of the display, 0 - the next disc can be flipped.       *
+ *----------------------------------------------------------------------------------*/
+uint32_t FlipDisc::FlipGapWait(uint8_t module_position)
+{
+  if(module_position >= 8) return 0;
+  
+  uint32_t gap_time = clock_micros() - moduleGapStartArray[module_position];
+  
+  if(gap_time >= moduleGapArray[module_position]) return 0;
+  return moduleGapArray[module_position] - gap_time;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function returns the delay effect of the display in microseconds -          *
+ * its own delay effect or the delay effect of all displays.                        *
+ *----------------------------------------------------------------------------------*/
+uint32_t FlipDisc::ModuleDelay(uint8_t module_position)
+{
+  if((module_position < 8) && (((module_delay_mask >> module_position) & 0b00000001) == 1)) return moduleDelayArray[module_position];
+  return flip_delay;
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function is used to sending empty data to complete the control data string.  *
+ * -> module_number - (1-8) the relative position of the display in relation        *
+ *    to the displays of the selected type                                          *
+ * -> module_type - (D7SEG, D2X1, D3X1, D1X3, D1X7) selected display type           *
+ * -> data_position - ("BEFORE", "AFTER") order of sending data, BEFORE control data*
+ *    or AFTER control data.                                                        *
+ *                                                                                  *
+ * Brief:                                                                           *
+ * First, based on the arguments, the function determines the absolute position     *
+ * of the selected display in the series of all displays. Then, based on the        *
+ * information about the types of displays BEFORE or AFTER the currently selected   *
+ * display, it prepares an empty data frame "0" and sends this data.                *
+ * For proper control of the display, the so-called empty supplementary data frames *
+ * are absolutely necessary!                                                        *
+ * The point is that we can only control one disc out of all connected display      *
+ * modules at a time. So in the entire data frame for e.g. eight 7-Segment displays,* 
+ * for 24 bytes of data there are only 2 bits set to "1" and the remaining 190 bits *
+ * must be set to "0".                                                              *
+ * The architecture of the embedded display controller requires it.                 *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::SendBlankData(uint8_t module_number, uint8_t module_type, uint8_t data_position)
+{
+  uint8_t empty_byte = 0;
+
+  for(int module_absolute_position = 0; module_absolute_position < 8; module_absolute_position++)
+  {  
+    // Look for the selected display type
+    if(moduleInitArray[module_absolute_position][module_type_column] == module_type)
+    { 
+     /*
+      * Then look for a specific display based on a relative number from a series 
+      * of displays of the same type. Based on these two parameters "module_number" and 
+      * "module_type" we determined the absolute position of the display "module_absolute_position". 
+      * Then, based on the absolute position of the display, we calculate the empty data frame "0"
+      * and sending this data.
+      */
+      if(moduleInitArray[module_absolute_position][module_relative_position_column] == module_number)
+      {       
+        if(data_position == BEFORE)
+        {
+          // In the calculation, we omit the currently selected display "(module_absolute_position + 1)"
+          for(int i = (module_absolute_position + 1); i < 8; i++) empty_byte = moduleInitArray[i][number_bytes_column] + empty_byte;     
+          for(int j = 0; j < empty_byte; j++) SpiTransfer(0);
+#if FLIPDISC_STATS
+          flip_stats.padding_bytes = flip_stats.padding_bytes + empty_byte;
+#endif
+          return;     
+        }
+        
+        if(data_position == AFTER)
+        {
+          // In the calculation, we omit the currently selected display "(module_absolute_position - 1)"
+          for(int i = 0; i <= (module_absolute_position - 1); i++) empty_byte = moduleInitArray[i][number_bytes_column] + empty_byte;
+          for(int j = 0; j < empty_byte; j++) SpiTransfer(0);
+#if FLIPDISC_STATS
+          flip_stats.padding_bytes = flip_stats.padding_bytes + empty_byte;
+#endif
+          return;      
+        }
+      }
+    }
+  }   
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * This function is used to disable all outputs of all displays in order to protect *
+ * the displays against incorrect control or failure of the power module.           *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::ClearAllOutputs(void)
+{
+  // Nothing has been sent to the displays if the calls are saved in the queue,
+  // queue_input belongs to the driver task when it is running
+  if(DriverInput() == true) return;
+  if(queue_input == true) return;
+  
+  // Start of SPI data transfer
+  PinWrite(_EN_PIN, LOW);
 
   // Clear all outputs of connected displays 
-  for(int i = 0; i < number_all_bytes; i++) SPI.transfer(0);
+  for(int i = 0; i < number_all_bytes; i++) SpiTransfer(0);
 
   // End of SPI data transfer
-  digitalWrite(_EN_PIN, HIGH);
+  PinWrite(_EN_PIN, HIGH);
+
+#if FLIPDISC_STATS
+  flip_stats.clear_bytes = flip_stats.clear_bytes + number_all_bytes;
+#endif
+
+  // In the DIRECT mode the display function ends with clearing all outputs
+  if(update_mode == DIRECT) UpdateEnd();
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function clears all outputs after the discs taken from the queue have been   *
+ * flipped. ClearAllOutputs() alone does nothing while the display calls are        *
+ * saved in the queue.                                                              *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::ClearQueueOutputs(void)
+{
+  queue_input = false;
+  ClearAllOutputs();
+  queue_input = (update_mode == QUEUE);
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function sets the control pin and saves the edge in the trace.               *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::PinWrite(uint16_t pin_number, uint8_t pin_level)
+{
+  digitalWrite(pin_number, pin_level);
+  
+  if(traceArray == NULL) return;
+  
+  if(pin_number == _EN_PIN) TraceSave(trace_en, pin_level);
+  else if(pin_number == _CH_PIN) TraceSave(trace_ch, pin_level);
+  else if(pin_number == _PL_PIN) TraceSave(trace_pl, pin_level);
 }
 
 /*----------------------------------------------------------------------------------*
@@ -1670,27 +4794,167 @@ void FlipDisc::ClearAllOutputs(void)
  *----------------------------------------------------------------------------------*/
 void FlipDisc::PrepareCurrentPulse(void)
 {			
-  digitalWrite(_PL_PIN, LOW);    // Turn OFF PSPS module output
-  digitalWrite(_CH_PIN, HIGH);   // Turn ON charging
-  delay(1000);                   // First charging time 1000ms
-  digitalWrite(_CH_PIN, LOW);    // Turn OFF charging
+  PinWrite(_PL_PIN, LOW);    // Turn OFF PSPS module output
+  PinWrite(_CH_PIN, HIGH);   // Turn ON charging
+  clock_wait(1000000UL);         // First charging time 1000ms
+  PinWrite(_CH_PIN, LOW);    // Turn OFF charging
 }
 
 /*----------------------------------------------------------------------------------*
  * Private function                                                                 *
  * The function is used to generate a current pulse of 1ms length                   *
- * required by flip-disc displays.                                                  *
- *----------------------------------------------------------------------------------*/
-void FlipDisc::ReleaseCurrentPulse(void)
-{
-  digitalWrite(_PL_PIN, LOW);    // Turn OFF PSPS module output
-  digitalWrite(_CH_PIN, HIGH);   // Turn ON charging
-  delayMicroseconds(100);        // Charging time 100us
-  digitalWrite(_CH_PIN, LOW);    // Turn OFF charging 
-  digitalWrite(_PL_PIN, HIGH);   // Turn ON PSPS module output
-  delay(1);                      // 1ms current pulse
-  digitalWrite(_PL_PIN, LOW);    // Turn OFF PSPS module output
-  FlipDelay();                   // Delay effect between flip discs
+ * required by flip-disc displays and to save the new status of the flipped disc.   *
+ * -> module_type, module_number - the display of the flipped disc                  *
+ * -> disc_number - disc number 0-35 counting from 0 for all display types          *
+ * -> disc_status - the status released into the disc                               *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::ReleaseCurrentPulse(uint8_t module_type, uint8_t module_number, uint8_t disc_number, bool disc_status)
+{
+  uint8_t module_position = ModulePosition(module_number, module_type);
+  
+  while(FlipGapWait(module_position) > 0) ClockIdle(FlipGapWait(module_position));  // Wait for the scheduled delay effect of the display
+  FlipRateTake();                // Wait for the flip-rate governor
+  if(update_mode == DIRECT) UpdateStart();  // The first pulse of the update in the DIRECT mode
+  StateInvalidate(module_position, disc_number, disc_status);  // The saved state becomes stale
+  
+#if FLIPDISC_STATS
+  uint32_t phase_start = clock_micros();
+#endif
+  PinWrite(_PL_PIN, LOW);    // Turn OFF PSPS module output
+  PinWrite(_CH_PIN, HIGH);   // Turn ON charging
+  clock_wait(100);               // Charging time 100us
+  PinWrite(_CH_PIN, LOW);    // Turn OFF charging 
+#if FLIPDISC_STATS
+  flip_stats.charge_time = flip_stats.charge_time + (clock_micros() - phase_start);
+  phase_start = clock_micros();
+#endif
+  
+  PinWrite(_PL_PIN, HIGH);   // Turn ON PSPS module output
+  clock_wait(1000);              // 1ms current pulse
+  PinWrite(_PL_PIN, LOW);    // Turn OFF PSPS module output
+#if FLIPDISC_STATS
+  flip_stats.pulse_time = flip_stats.pulse_time + (clock_micros() - phase_start);
+  flip_stats.pulses = flip_stats.pulses + 1;
+  spi_frame_bytes = spi_frame_bytes + number_all_bytes;
+#endif
+  
+  SaveDiscStatus(module_type, module_number, disc_number, disc_status);
+  FlipDelay(module_position);    // Delay effect between flip discs
+}
+
+/*----------------------------------------------------------------------------------*
+ * Private function                                                                 *
+ * The function saves the status released into the disc. From now on the status    *
+ * of the disc is known. If the disc was waiting in the queue for the same status,  *
+ * the pending flip is no longer needed.                                            *
+ *----------------------------------------------------------------------------------*/
+void FlipDisc::SaveDiscStatus(uint8_t module_type, uint8_t module_number, uint8_t disc_number, bool disc_status)
+{
+  uint8_t module_position = ModulePosition(module_number, module_type);
+  if(module_position == 0xFF) return;
+
+  // The disc has really turned over only if its status was unknown or different
+  bool disc_turned = (ReadDiscBit(discKnownArray, module_position, disc_number) == 0) || 
+                     (ReadDiscBit(discStateArray, module_position, disc_number) != disc_status);
+
+  WriteDiscBit(discStateArray, module_position, disc_number, disc_status);
+  WriteDiscBit(discKnownArray, module_position, disc_number, 1);
+
+  last_flip_time = clock_millis();
+
+  if(ReadDiscBit(discTargetArray, module_position, disc_number) == disc_status) 
+  {
+    DriverLock();
+    WriteDiscBit(discPendingArray, module_position, disc_number, 0);
+    DriverUnlock();
+  }
+
+  // The pulses into a disc already showing the status are not mechanical wear
+  if(disc_turned == true) WearCount(module_position, disc_number);
+  
+#if defined(FLIPDISC_EEPROM)
+  if(disc_turned == true) StateChanged();
+#endif
+
+  if(flip_callback != NULL) flip_callback(module_type, module_number, disc_number, disc_status, clock_micros());
+}
+
+/*----------------------------------------------------------------------------------*
+ * Handle of the display update returned by Display_7Seg() and Display_3x5().       *
+ * In the QUEUE mode the update advances when the queue is serviced by Step(),      *
+ * Service() or Flush(), so the user code can check the handle and do other         *
+ * work in the meantime. The handle follows the display, not the single call -      *
+ * a newer call for the same display extends the update.                           *
+ * -> module_position - absolute position of the display 0-7, 0xFF - no display     *
+ *----------------------------------------------------------------------------------*/
+FlipTask::FlipTask(uint8_t module_position /* = 0xFF */)
+{
+  task_position = module_position;
+  task_size = 0;
+
+  if(task_position >= 8) return;
+
+  DriverLock();
+  task_size = ModulePending(task_position);
+  DriverUnlock();
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function returns 1 if all discs of the update have been flipped.             *
+ *----------------------------------------------------------------------------------*/
+bool FlipTask::Done(void)
+{
+  if(task_position >= 8) return 1;
+
+  DriverLock();
+  uint8_t pending_discs = ModulePending(task_position);
+  DriverUnlock();
+
+  return (pending_discs == 0);
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function returns the progress of the update in percent 0-100.                *
+ *----------------------------------------------------------------------------------*/
+uint8_t FlipTask::Progress(void)
+{
+  if((task_position >= 8) || (task_size == 0)) return 100;
+
+  DriverLock();
+  uint8_t pending_discs = ModulePending(task_position);
+  DriverUnlock();
+
+  if(pending_discs >= task_size) return 0;
+  
+  return ((task_size - pending_discs) * 100) / task_size;
+}
+
+/*----------------------------------------------------------------------------------*
+ * The function sets the completion callback of the update. The callback is         *
+ * called once, from Step(), Service() or Flush(), after the last disc of           *
+ * the display has been flipped. If the update is already done, the callback        *
+ * is called immediately. One callback for each display, a newer one replaces       *
+ * the previous one, NULL cancels the callback waiting for the display.             *
+ * -> task_callback - function without arguments, e.g. void DigitDone(void)        *
+ *----------------------------------------------------------------------------------*/
+void FlipTask::OnDone(void (*task_callback)(void))
+{
+  if(task_position >= 8)
+  {
+    if(task_callback != NULL) task_callback();
+    return;
+  }
+
+  // The driver task must not finish the update between the check and the registration
+  DriverLock();
+  bool task_done = (ModulePending(task_position) == 0);
+  
+  // The callback called at once also replaces the one waiting for the display
+  if(task_done == false) taskCallbackArray[task_position] = task_callback;
+  else taskCallbackArray[task_position] = NULL;
+  DriverUnlock();
+
+  if((task_done == true) && (task_callback != NULL)) task_callback();
 }
 
 /*----------------------------------------------------------------------------------*
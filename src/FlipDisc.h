@@ -73,6 +73,7 @@ static const uint8_t HLA = 43;   // HLA - "≡"  - All three lines
 static const uint8_t VLL = 44;   // VLL - "| " - Vertical line - left
 static const uint8_t VLR = 1 ;   // VLR - " |" - Vertical line - right
 static const uint8_t VLA = 45;   // VLA - "||" - All Vertical lines
+static const uint8_t DOT = 50;   // DOT - "."  - Dot symbol for 3x5 display
 
 // Codenames of symbols for 3x3 display
 static const uint8_t CAD = 10;   // CAD - Clear all discs
@@ -82,10 +83,67 @@ static const uint8_t SAD = 11;   // SAD - Set all discs
 static const uint8_t BEFORE = 0xAA;
 static const uint8_t AFTER = 0xBB;
 
-// Codenames for the moduleInitArray[][3] columns
+// Codenames for the moduleInitArray[][5] columns
 static const uint8_t module_type_column = 0;
 static const uint8_t number_bytes_column = 1;
 static const uint8_t module_relative_position_column = 2;
+static const uint8_t number_discs_column = 3;
+static const uint8_t module_priority_column = 4;
+
+// Codenames for the Mode() function
+static const uint8_t DIRECT = 0xD0;
+static const uint8_t QUEUE  = 0xD1;
+
+// Codenames for the Clock() function
+static const uint8_t REAL_CLOCK    = 0xC0;
+static const uint8_t VIRTUAL_CLOCK = 0xC1;
+
+// Number of slots in the frame buffer - the frame being written and up to three waiting frames
+static const uint8_t frame_buffer_size = 4;
+
+/*
+ * Performance counters of GetStats() and ResetStats(): 1 - compiled (default), 
+ * 0 - the counters, GetStats() and ResetStats() are removed and cost no time 
+ * and no RAM. Change the value here or with the build flag -DFLIPDISC_STATS=0.
+ */
+#ifndef FLIPDISC_STATS
+#define FLIPDISC_STATS 1
+#endif
+
+#if FLIPDISC_STATS
+/*
+ * Performance counters returned by GetStats()
+ * -> pulses - current pulses released
+ * -> pulses_skipped - flips not needed, the disc already showed the status
+ * -> pulses_saved - flips skipped by the lookahead planner, see Lookahead()
+ * -> payload_bytes - SPI bytes with the control data of the flipped display
+ * -> padding_bytes - SPI bytes of the empty data for the other displays, see SendBlankData()
+ * -> clear_bytes - SPI bytes sent by ClearAllOutputs()
+ * -> charge_time, pulse_time, delay_time - time in the charging, current pulse 
+ *    and delay effect phases in microseconds
+ * -> throttle_count, throttle_time - flips held by the flip-rate governor and their time in us
+ * -> update_count - number of updates: display function calls in the DIRECT mode, 
+ *    from the first queued disc until the queue is empty in the QUEUE mode
+ * -> update_time_max, update_time_avg - maximum and average time of the updates in microseconds
+ */
+typedef struct
+{
+  uint32_t pulses;
+  uint32_t pulses_skipped;
+  uint32_t pulses_saved;
+  uint32_t payload_bytes;
+  uint32_t padding_bytes;
+  uint32_t clear_bytes;
+  uint32_t charge_time;
+  uint32_t pulse_time;
+  uint32_t delay_time;
+  uint32_t throttle_count;
+  uint32_t throttle_time;
+  uint32_t update_count;
+  uint32_t update_time_max;
+  uint32_t update_time_avg;
+} FlipStats;
+#endif
 
 // Codenames for all 3x3 type displays
 static const uint8_t DICE = 0xDD;
@@ -460,7 +518,7 @@ static const uint8_t diceArray_3x3[12][2] PROGMEM =
   {0b01010101, 0b00000001}, // 5
   {0b01101101, 0b00000001}, // 6 
   {0b01111101, 0b00000001}, // 7 
-  {0b11101111, 0b00000001}, // 6
+  {0b11101111, 0b00000001}, // 8
   {0b11111111, 0b00000001}, // 9
   {0b00000000, 0b00000000}, // 10/CAD - clear all discs
   {0b11111111, 0b00000001}  // 11/SAD - set all discs  
@@ -825,8 +883,74 @@ static const uint8_t numbArray_4x3x3[12][2] PROGMEM =
   {0b00000000, 0b00000000}, // 10/CAD - clear all discs
   {0b11111111, 0b00000001}  // 11/SAD - set all discs
 };
- 
-class FlipDisc
+
+/* 
+ * Refers to "D7SEG" - 7-segment display
+ * Symbols of the ASCII characters 0x20-0x7F shown by the text output - see Text().
+ * Lowercase letters are shown as uppercase, characters without a symbol as HLA - "≡".
+ * NONE - the character does not take a display: ".", ":" and ",".
+ * "%" takes two displays - PFH and PSH.
+ */
+static const uint8_t charArray_7Seg[96] PROGMEM =
+{
+//  " "  "!"  """  "#"  "$"  "%"  "&"  "'"  "("  ")"  "*"  "+"  ","   "-"  "."   "/"
+    CLR, HLA, HLA, HLA, HLA, PFH, HLA, HLA, C,   HLA, HLA, HLA, NONE, HLM, NONE, HLA,
+//  "0"  "1"  "2"  "3"  "4"  "5"  "6"  "7"  "8"  "9"  ":"   ";"  "<"  "="  ">"  "?"
+    0,   1,   2,   3,   4,   5,   6,   7,   8,   9,   NONE, HLA, HLA, HLT, HLA, HLA,
+//  "@"  "A"  "B"  "C"  "D"  "E"  "F"  "G"  "H"  "I"  "J"  "K"  "L"  "M"  "N"  "O"
+    HLA, A,   B,   C,   D,   E,   F,   G,   H,   I,   J,   K,   L,   M,   N,   O,
+//  "P"  "Q"  "R"  "S"  "T"  "U"  "V"  "W"  "X"  "Y"  "Z"  "["  "\"  "]"  "^"  "_"
+    P,   Q,   R,   S,   T,   U,   V,   W,   X,   Y,   Z,   C,   HLA, HLA, HLA, HLL,
+//  "`"  "a"  "b"  "c"  "d"  "e"  "f"  "g"  "h"  "i"  "j"  "k"  "l"  "m"  "n"  "o"
+    HLA, A,   B,   C,   D,   E,   F,   G,   H,   I,   J,   K,   L,   M,   N,   O,
+//  "p"  "q"  "r"  "s"  "t"  "u"  "v"  "w"  "x"  "y"  "z"  "{"  "|"  "}"  "~"  DEL
+    P,   Q,   R,   S,   T,   U,   V,   W,   X,   Y,   Z,   C,   VLL, HLA, HLA, HLA
+};
+
+/* 
+ * Refers to "D3X5" - 3x5 display
+ * Symbols of the ASCII characters 0x20-0x7F shown by the text output - see Text().
+ * Lowercase letters are shown as uppercase, characters without a symbol as "?"/66/QST.
+ */
+static const uint8_t charArray_3x5[96] PROGMEM =
+{
+//  " "  "!"  """  "#"  "$"  "%"  "&"  "'"  "("  ")"  "*"  "+"  ","  "-"  "."  "/"
+    CLR, 65,  54,  63,  64,  PRC, 62,  53,  57,  58,  48,  47,  52,  MIN, 50,  55,
+//  "0"  "1"  "2"  "3"  "4"  "5"  "6"  "7"  "8"  "9"  ":"  ";"  "<"  "="  ">"  "?"
+    0,   1,   2,   3,   4,   5,   6,   7,   8,   9,   51,  66,  59,  46,  60,  66,
+//  "@"  "A"  "B"  "C"  "D"  "E"  "F"  "G"  "H"  "I"  "J"  "K"  "L"  "M"  "N"  "O"
+    61,  A,   B,   C,   D,   E,   F,   G,   H,   I,   J,   K,   L,   M,   N,   O,
+//  "P"  "Q"  "R"  "S"  "T"  "U"  "V"  "W"  "X"  "Y"  "Z"  "["  "\"  "]"  "^"  "_"
+    P,   Q,   R,   S,   T,   U,   V,   W,   X,   Y,   Z,   57,  56,  58,  66,  HLL,
+//  "`"  "a"  "b"  "c"  "d"  "e"  "f"  "g"  "h"  "i"  "j"  "k"  "l"  "m"  "n"  "o"
+    53,  A,   B,   C,   D,   E,   F,   G,   H,   I,   J,   K,   L,   M,   N,   O,
+//  "p"  "q"  "r"  "s"  "t"  "u"  "v"  "w"  "x"  "y"  "z"  "{"  "|"  "}"  "~"  DEL
+    P,   Q,   R,   S,   T,   U,   V,   W,   X,   Y,   Z,   57,  VLL, 58,  49,  66
+};
+
+/*
+ * Handle of the display update returned by Display_7Seg() and Display_3x5(),
+ * see FlipDisc.cpp for details
+ */
+class FlipTask
+{
+  public:
+    FlipTask(uint8_t module_position = 0xFF);
+    bool Done(void);
+    uint8_t Progress(void);
+    void OnDone(void (*task_callback)(void));
+
+  private:
+    uint8_t task_position;
+    uint8_t task_size;
+};
+
+/*
+ * FlipDisc is a Print, so print() and println() show the text on the displays, see Text()
+ * and write(). Only println(), Text(), Home() and Number() bring the cursor back to
+ * the first display - a bare print() in loop() needs Home() before it.
+ */
+class FlipDisc : public Print
 {
   public:
     FlipDisc();
@@ -835,7 +959,7 @@ class FlipDisc
               uint8_t MOD5 = 0xFF, uint8_t MOD6 = 0xFF, uint8_t MOD7 = 0xFF, uint8_t MOD8 = 0xFF);
 
     void Disc_7Seg(uint8_t module_number, uint8_t disc_number, bool disc_status);
-    void Display_7Seg(uint8_t module_number, uint8_t new_data);
+    FlipTask Display_7Seg(uint8_t module_number, uint8_t new_data);
     void Matrix_7Seg(uint8_t data1, uint8_t data2 = 0xFF, uint8_t data3 = 0xFF, uint8_t data4 = 0xFF,
                      uint8_t data5 = 0xFF, uint8_t data6 = 0xFF, uint8_t data7 = 0xFF, uint8_t data8 = 0xFF);
 
@@ -862,25 +986,126 @@ class FlipDisc
     void Display_3x4(uint8_t module_number, uint8_t row_number, uint8_t column_number, bool disc_status);
 
     void Disc_3x5(uint8_t module_number, uint8_t discNumber, bool disc_status);
-    void Display_3x5(uint8_t module_number, uint8_t new_data);
+    FlipTask Display_3x5(uint8_t module_number, uint8_t new_data);
     void Matrix_3x5(uint8_t data1, uint8_t data2 = 0xFF, uint8_t data3 = 0xFF, uint8_t data4 = 0xFF, 
                     uint8_t data5 = 0xFF, uint8_t data6 = 0xFF, uint8_t data7 = 0xFF, uint8_t data8 = 0xFF);
 						 
+    void Text(uint8_t module_type, uint8_t module_number = 1);
+    void Home(void);
+    virtual size_t write(uint8_t character);
+    using Print::write;
+    bool Number(int32_t value, uint8_t decimals = 0, uint8_t unit = NONE);
+    void Hysteresis(uint32_t threshold, uint16_t stable_time = 0);
+
     void Disc_4x3x3(uint8_t module_number, uint8_t discNumber, bool disc_status);
     void Display_4x3x3(uint8_t module_number, uint8_t section_number, uint8_t new_data, uint8_t data_type);
 	
     void Delay(uint8_t new_time_delay);
+    void DelayMicros(uint32_t new_time_delay);
+    void Delay(uint8_t module_type, uint8_t module_number, uint8_t new_time_delay);
+    void DelayMicros(uint8_t module_type, uint8_t module_number, uint32_t new_time_delay);
+    void FlipRate(uint16_t flips_per_second, uint8_t burst = 1);
+    uint32_t ThrottleCount(void);
+    uint32_t ThrottleTime(void);
+#if FLIPDISC_STATS
+    FlipStats GetStats(void);
+    void ResetStats(void);
+#endif
+    bool WearBegin(uint16_t eeprom_address, uint8_t eeprom_slots = 2);
+    void WearSave(void);
+    uint32_t Wear(uint8_t module_type, uint8_t module_number, uint8_t disc_number);
+    bool StateBegin(uint16_t eeprom_address, uint16_t save_interval = 600, bool restore = 1);
+    void StateSave(void);
+    void Clock(uint8_t clock_source);
+    void Clock(uint32_t (*new_clock_micros)(void), uint32_t (*new_clock_millis)(void), void (*new_clock_wait)(uint32_t wait_time));
+    uint32_t ClockMicros(void);
+    uint32_t ClockMillis(void);
+    void ClockWait(uint32_t wait_time);
+    bool TraceBegin(uint16_t trace_records);
+    void TraceDump(Print &output);
     void Test(void);
     void All(void);
     void Clear(void);
+
+    void Mode(uint8_t new_update_mode);
+    void Flush(void);
+    bool Step(void);
+    uint16_t Service(uint32_t max_us);
+    void Priority(uint8_t module_type, uint8_t module_number, uint8_t priority);
+    bool FrameRate(uint8_t frames_per_second);
+    void Frame(void);
+    uint32_t FramesDropped(void);
+    void Lookahead(uint16_t hold_time);
+    uint32_t PulsesSaved(void);
+    void Refresh(uint16_t new_refresh_interval);
+    void Unknown(void);
+    void Unknown(uint8_t module_type, uint8_t module_number, uint8_t first_disc = 0xFF, uint8_t last_disc = 0xFF);
+    void OnFlip(void (*new_flip_callback)(uint8_t module_type, uint8_t module_number, uint8_t disc_number, bool disc_status, uint32_t flip_time));
+    void OnFrame(void (*new_frame_callback)(void));
+    void OnEmpty(void (*new_empty_callback)(void));
+#if defined(ARDUINO_ARCH_ESP32)
+    bool Driver(uint8_t driver_core = 0, uint8_t driver_priority = 1);
+#endif
+    uint16_t Pending(void);
+    void Deadline(uint32_t visible_at);
+    int32_t DeadlineMiss(void);
+
+    uint32_t Estimate_7Seg(uint8_t module_number, uint8_t new_data);
+    uint32_t Estimate_3x3(uint8_t module_number, uint8_t new_data, uint8_t data_type);
+    uint32_t Estimate_3x5(uint8_t module_number, uint8_t new_data);
+    uint32_t Estimate_4x3x3(uint8_t module_number, uint8_t section_number, uint8_t new_data, uint8_t data_type);
         
   private:
-    void FlipDelay(void);
+    void FlipDelay(uint8_t module_position);
+    uint32_t FlipGapWait(uint8_t module_position);
+    uint32_t QueueGapWait(void);
+    uint32_t ModuleDelay(uint8_t module_position);
+    uint32_t FlipRateWait(void);
+    void FlipRateTake(void);
     void SendBlankData(uint8_t module_number, uint8_t module_type, uint8_t data_position);
     void ClearAllOutputs(void);
+    void ClearQueueOutputs(void);
+    void PinWrite(uint16_t pin_number, uint8_t pin_level);
     void PrepareCurrentPulse(void);
-    void ReleaseCurrentPulse(void);
+    void ReleaseCurrentPulse(uint8_t module_type, uint8_t module_number, uint8_t disc_number, bool disc_status);
+    void SaveDiscStatus(uint8_t module_type, uint8_t module_number, uint8_t disc_number, bool disc_status);
     bool Fuse(uint8_t module_number, uint8_t module_type);
+    bool DiscFuse(uint8_t module_number, uint8_t module_type, uint8_t disc_number);
+    void DisplayDots(uint8_t module_type, uint8_t module_number, uint8_t disc1, uint8_t disc2, uint8_t disc3);
+    void TextSymbol(uint8_t new_data);
+    void TextCodePoint(uint32_t code_point);
+    bool SymbolShown(uint8_t module_position, uint8_t new_data);
+    uint8_t ModulePosition(uint8_t module_number, uint8_t module_type);
+    bool Queue(uint8_t module_type, uint8_t module_number, uint8_t disc_number, bool disc_status);
+    bool DeadlineWait(void);
+    uint32_t FlipTime(uint8_t module_position = 0xFF);
+    uint32_t PulseTime(void);
+    bool FlipNeeded(uint8_t module_position, uint8_t disc_number, bool disc_status);
+    bool NextQueuedDisc(uint8_t &module_position, uint8_t &disc_number);
+    bool FlipNextQueuedDisc(void);
+    void QueueDisc(uint8_t module_position, uint8_t disc_number, bool disc_status);
+    void FrameToQueue(bool frame_force);
+    bool FlipReverted(uint8_t module_position, uint8_t disc_number, bool disc_status);
+    void QueueInput(uint8_t module_position, uint8_t disc_number, bool disc_status);
+    bool DriverInput(void);
+    void DriverPush(uint8_t module_position, uint8_t disc_number, bool disc_status);
+    void DriverPull(void);
+#if defined(ARDUINO_ARCH_ESP32)
+    static void DriverTask(void *driver_parameters);
+#endif
+    void TaskDone(void);
+    void QueueEmpty(void);
+    void UpdateStart(void);
+    void UpdateEnd(void);
+    void WearCount(uint8_t module_position, uint8_t disc_number);
+    bool WearSaveStep(uint32_t max_time);
+    void StateAutoSave(void);
+    bool StateSaveStep(uint32_t max_time);
+    void EepromSave(void);
+    void StateInvalidate(uint8_t module_position, uint8_t disc_number, bool disc_status);
+    void UnknownDisc(uint8_t module_position, uint8_t disc_number);
+    bool RefreshNextDisc(void);
+    void FlipQueuedDisc(uint8_t module_position, uint8_t disc_number, bool disc_status);
 };
 
 extern FlipDisc Flip;